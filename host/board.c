@@ -0,0 +1,368 @@
+// Virtual watch board for the host build; see board.h
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "rtc_model.h"
+#include "eeprom.h"
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+
+// oscillator clocks per second
+#define CLK_PER_S  (SYSCLK * 1000.0)
+
+// SFRs; ports come up high like the real ones
+volatile board_sfr_t board_p0 = { 0xFF }, board_p1 = { 0xFF }, board_p3 = { 0xFF };
+volatile board_sfr_t board_ie, board_tcon;
+volatile uint8_t PCON, TMOD, TL0, TH0, CLK_DIV, WDT_CONTR, WKTCL, WKTCH;
+volatile uint8_t P0M0, P0M1, P1M0, P1M1, P2M0, P2M1, P3M0, P3M1;
+volatile uint8_t IAP_DATA, IAP_ADDRH, IAP_ADDRL, IAP_CMD, IAP_TRIG, IAP_CONTR;
+
+// character shown for each LED_ index of ledtable[] (eeprom.h); patterns
+// not found there are looked up in its ASCII half
+static const char glyphs[] = "0123456789AbCdEF -h.rHonMtuSWLi'";
+
+static uint64_t now;		// oscillator clocks since reset
+static uint64_t next_t0;	// next timer0 overflow, 0 when not running
+static uint64_t end;		// end of the run
+static uint8_t quiet;
+static double vcc_start = 3000, vcc_stop = 3000;	// mV
+
+// wake-up timer wakes: how many, and the clocks spent awake after them
+// until the next power down (only those that went straight back to sleep).
+// the virtual board only times the DS1302 bus, so the C code of the wake
+// path (the loop around power down, pins_set() twice, the minute compare)
+// is added as WKT_C_CLOCKS: an estimate from the instruction timings, not
+// a measurement
+#define WKT_C_CLOCKS  260
+static uint64_t wkt_woke;	// time of the last wake-up timer wake, 0 if none
+static uint32_t wkt_wakes;
+static uint64_t wkt_active;
+
+// data flash, as seen through the IAP registers, and its image file.
+// byte program and sector erase times are from the STC15 datasheet
+#define IAP_PROGRAM_S  55e-6
+#define IAP_ERASE_S    21e-3
+static uint8_t flash[EE_SIZE];
+static const char *flash_file;
+static uint32_t flash_writes, flash_erases;
+
+// button script
+#define BOARD_PRESSES 64
+static struct {
+	uint8_t button;
+	uint64_t down, up;
+} presses[BOARD_PRESSES];
+static uint8_t npresses;
+
+// segments last shown on each digit (and which were lit since the last
+// refresh period), the last refresh period and the last frame printed.
+// a frame has to last two refresh periods, so the mix of old and new
+// digits shown while the display buffer is rewritten is not a frame.
+static uint8_t segs[4];
+static uint8_t segs_lit;
+static uint8_t seen[4];
+static uint64_t seen_time;
+static uint8_t frame[4];
+static uint64_t frame_time;
+
+static void fail(const char *msg)
+{
+	fprintf(stderr, "board: %s at %.3f s\n", msg, now / CLK_PER_S);
+	exit(1);
+}
+
+static void print_frame(void)
+{
+	uint8_t i, k;
+	char c;
+
+	printf("%9.3f  ", frame_time / CLK_PER_S);
+	for (i = 0; i < 4; i++) {
+		c = '?';
+		for (k = 0; k < EE_LEDTABLE_SIZE; k++) {
+			if ((ledtable[k] | 0x80) == (frame[i] | 0x80)) {
+				c = k < sizeof(glyphs) - 1 ? glyphs[k] : k;
+				break;
+			}
+		}
+		putchar(c);
+		if (!(frame[i] & 0x80) && c != '.') {
+			putchar('.');
+		}
+	}
+	putchar('\n');
+}
+
+static void finish(void)
+{
+	if (quiet && frame_time) {
+		print_frame();
+	}
+	fprintf(stderr, "simulated %.3f s\n", now / CLK_PER_S);
+	if (wkt_wakes) {
+		fprintf(stderr, "%u wake-up timer wakes, %.1f us awake each (estimated)\n",
+		        (unsigned)wkt_wakes, wkt_active / CLK_PER_S * 1e6 / wkt_wakes);
+	}
+	if (flash_writes || flash_erases) {
+		fprintf(stderr, "data flash: %u bytes written, %u sector erases\n",
+		        (unsigned)flash_writes, (unsigned)flash_erases);
+	}
+	if (flash_file) {
+		FILE *f = fopen(flash_file, "wb");
+
+		if (!f || fwrite(flash, sizeof(flash), 1, f) != 1) {
+			fail("cannot save the data flash");
+		}
+		if (f) {
+			fclose(f);
+		}
+	}
+	if (rtc_violations()) {
+		fprintf(stderr, "%u DS1302 bus timing violations\n", (unsigned)rtc_violations());
+		exit(3);
+	}
+	exit(0);
+}
+
+// drive the button pins (active low) from the script
+static void buttons(void)
+{
+	uint8_t i, sw1 = 1, sw2 = 1;
+
+	for (i = 0; i < npresses; i++) {
+		if (presses[i].down <= now && now < presses[i].up) {
+			if (presses[i].button == 1) {
+				sw1 = 0;
+			} else {
+				sw2 = 0;
+			}
+		}
+	}
+	P3_3 = sw1;
+	P3_1 = sw2;
+}
+
+// record the digit timer0_isr has just lit; digit 0 is the last one of
+// each refresh period, so the frame is complete then
+static void display(void)
+{
+	uint8_t i;
+
+	switch (P3 & 0xF0) {
+		case 0x10: i = 0; break;
+		case 0x20: i = 1; break;
+		case 0x40: i = 2; break;
+		case 0x80: i = 3; break;
+		default: return;
+	}
+	segs[i] = P1;
+	segs_lit |= 1 << i;
+	if (i == 0) {
+		if (segs_lit == 0x0F) {
+			if (memcmp(segs, seen, sizeof(seen))) {
+				memcpy(seen, segs, sizeof(seen));
+				seen_time = now;
+			} else if (memcmp(seen, frame, sizeof(frame))) {
+				memcpy(frame, seen, sizeof(frame));
+				frame_time = seen_time;
+				if (!quiet) {
+					print_frame();
+				}
+			}
+		}
+		segs_lit = 0;
+	}
+}
+
+// timer0 counts SYSCLK/12 after the clock divider, from the reload value up
+static uint64_t t0_period(void)
+{
+	return (uint64_t)12 * (0x10000 - (TH0 << 8 | TL0)) << (CLK_DIV & 7);
+}
+
+static uint8_t t0_enabled(void)
+{
+	if (!(TR0 && ET0 && EA)) {
+		return 0;
+	}
+	if (next_t0 <= now) {
+		next_t0 = now + t0_period();
+	}
+	return 1;
+}
+
+// move the clock forward to 'to', delivering timer0 interrupts on the way
+static void advance(uint64_t to)
+{
+	if (to > end) {
+		to = end;
+	}
+	while (t0_enabled() && next_t0 <= to) {
+		now = next_t0;
+		next_t0 = now + t0_period();
+		buttons();
+		timer0_isr();
+		display();
+	}
+	now = to;
+	if (now == end) {
+		finish();
+	}
+}
+
+// the DS1302 sees the pins as they are when the time starts to pass,
+// and drives DS_IO for the time it ends
+void board_cycles(uint16_t n)
+{
+	rtc_bus(now);
+	advance(now + ((uint64_t)n << (CLK_DIV & 7)));
+	rtc_bus(now);
+}
+
+void board_idle(void)
+{
+	if (!t0_enabled()) {
+		fail("idle with the timer0 interrupt disabled");
+	}
+	advance(next_t0);
+}
+
+// the wake-up timer counts the ~32kHz low power oscillator divided by 16
+#define WKT_HZ  (32768 / 16)
+
+void board_power_down(void)
+{
+	uint8_t i, timer = 0;
+	uint64_t wake = end;
+
+	if (!(EX1 && EA)) {
+		fail("power down with INT1 disabled");
+	}
+
+	// back to sleep straight after a wake-up timer wake: count how long that took
+	if (wkt_woke && frame_time < wkt_woke) {
+		wkt_wakes++;
+		wkt_active += now - wkt_woke + WKT_C_CLOCKS;
+	} else if (!quiet) {
+		printf("%9.3f  power down\n", now / CLK_PER_S);
+	}
+
+	// the display is dark until the next frame
+	memset(frame, 0xFF, sizeof(frame));
+	memset(seen, 0xFF, sizeof(seen));
+	frame_time = now;
+
+	// wake up on the next SW1 press or when the wake-up timer runs out;
+	// the other timers stop meanwhile
+	if (WKTCH & 0x80) {
+		wake = now + (uint64_t)(((WKTCH & 0x7F) << 8 | WKTCL) + 1) * (uint64_t)CLK_PER_S / WKT_HZ;
+		timer = 1;
+	}
+	for (i = 0; i < npresses; i++) {
+		if (presses[i].button == 1 && presses[i].down >= now && presses[i].down < wake) {
+			wake = presses[i].down;
+			timer = 0;
+		}
+	}
+	if (wake >= end) {
+		now = end;
+		finish();
+	}
+	now = wake;
+	next_t0 = 0;
+	segs_lit = 0;
+	buttons();
+	wkt_woke = timer ? now : 0;
+	if (!timer) {
+		INT1_routine();
+	}
+}
+
+void board_iap(void)
+{
+	uint16_t addr = IAP_ADDRH << 8 | IAP_ADDRL;
+
+	if (!(IAP_CONTR & 0x80)) {
+		fail("IAP command with the IAP disabled");
+		return;
+	}
+	if (addr >= EE_SIZE) {
+		fail("IAP address outside the data flash");
+		return;
+	}
+	switch (IAP_CMD) {
+	case 1:
+		IAP_DATA = flash[addr];
+		break;
+	case 2:
+		if (IAP_DATA & ~flash[addr]) {
+			fail("IAP write to flash that was not erased");
+		}
+		flash[addr] &= IAP_DATA;
+		flash_writes++;
+		advance(now + (uint64_t)(IAP_PROGRAM_S * CLK_PER_S));
+		break;
+	case 3:
+		memset(flash + (addr & ~(EE_SECTOR_SIZE - 1)), 0xFF, EE_SECTOR_SIZE);
+		flash_erases++;
+		advance(now + (uint64_t)(IAP_ERASE_S * CLK_PER_S));
+		break;
+	}
+}
+
+void board_flash(const char *file)
+{
+	flash_file = file;
+}
+
+void board_brownout(void)
+{
+	PCON |= 0x20;
+}
+
+void board_press(uint8_t button, double down, double up)
+{
+	if (npresses == BOARD_PRESSES) {
+		fail("too many button presses");
+	}
+	presses[npresses].button = button;
+	presses[npresses].down = (uint64_t)(down * CLK_PER_S);
+	presses[npresses].up = (uint64_t)(up * CLK_PER_S);
+	npresses++;
+}
+
+void board_vcc(double start, double stop)
+{
+	vcc_start = start;
+	vcc_stop = stop;
+}
+
+uint16_t board_vcc_mv(void)
+{
+	double f = end ? (double)now / end : 0;
+
+	return (uint16_t)(vcc_start + (vcc_stop - vcc_start) * (f < 1 ? f : 1) + 0.5);
+}
+
+void board_run(double seconds, uint8_t q)
+{
+	FILE *f = flash_file ? fopen(flash_file, "rb") : NULL;
+
+	memset(flash, 0xFF, sizeof(flash));
+	if (f) {
+		if (fread(flash, sizeof(flash), 1, f) != 1) {
+			fail("short data flash image");
+		}
+		fclose(f);
+	}
+	end = (uint64_t)(seconds * CLK_PER_S);
+	quiet = q;
+	buttons();
+	firmware_main();
+	fail("firmware returned");
+}
@@ -0,0 +1,89 @@
+// Virtual watch board for the host build
+//
+// Stands in for the STC15F204EA SFRs the firmware uses and keeps a virtual
+// clock, counted in oscillator clocks at SYSCLK. The DS1302 on the board is
+// rtc_model.c. Time only moves when the
+// firmware spends it: board_cycles() for timed code (the DS1302 bus),
+// board_idle() and board_power_down() for the CPU sleep modes. timer0 and
+// INT1 interrupts are delivered as the clock passes them, the buttons follow
+// a script, and every complete display refresh is decoded into a frame.
+//
+
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+#include <stdint.h>
+
+// bit addressable SFR
+typedef union {
+	uint8_t byte;
+	struct {
+		uint8_t b0:1, b1:1, b2:1, b3:1, b4:1, b5:1, b6:1, b7:1;
+	} bit;
+} board_sfr_t;
+
+extern volatile board_sfr_t board_p0, board_p1, board_p3, board_ie, board_tcon;
+extern volatile uint8_t PCON, TMOD, TL0, TH0, CLK_DIV, WDT_CONTR, WKTCL, WKTCH;
+extern volatile uint8_t P0M0, P0M1, P1M0, P1M1, P2M0, P2M1, P3M0, P3M1;
+extern volatile uint8_t IAP_DATA, IAP_ADDRH, IAP_ADDRL, IAP_CMD, IAP_TRIG, IAP_CONTR;
+
+#define P0    (board_p0.byte)
+#define P0_0  (board_p0.bit.b0)
+#define P0_1  (board_p0.bit.b1)
+#define P1    (board_p1.byte)
+#define P3    (board_p3.byte)
+#define P3_1  (board_p3.bit.b1)
+#define P3_2  (board_p3.bit.b2)
+#define P3_3  (board_p3.bit.b3)
+#define IE    (board_ie.byte)
+#define EX0   (board_ie.bit.b0)
+#define ET0   (board_ie.bit.b1)
+#define EX1   (board_ie.bit.b2)
+#define EA    (board_ie.bit.b7)
+#define TCON  (board_tcon.byte)
+#define IT1   (board_tcon.bit.b2)
+#define IE1   (board_tcon.bit.b3)
+#define TR0   (board_tcon.bit.b4)
+#define TF0   (board_tcon.bit.b5)
+
+// the CPU spends n clocks (before the clock divider)
+void board_cycles(uint16_t n);
+
+// PCON.IDL: sleep until the next interrupt
+void board_idle(void);
+
+// PCON.PD: sleep until SW1 is pressed, or the wake-up timer (WKTCH:WKTCL)
+// runs out if it is enabled
+void board_power_down(void);
+
+// IAP_TRIG: run IAP_CMD on the data flash; the CPU stalls meanwhile
+void board_iap(void);
+
+// load the data flash from an image file if it exists (erased otherwise),
+// and save it there at the end of the run
+void board_flash(const char *file);
+
+// start up as after a low voltage reset (PCON.LVDF set)
+void board_brownout(void);
+
+// button script: button 1 or 2 is held down from time 'down' to 'up' (seconds)
+void board_press(uint8_t button, double down, double up);
+
+// supply voltage in mV: ramps from 'start' at reset to 'stop' at the end
+// of the run (3000 mV throughout by default)
+void board_vcc(double start, double stop);
+
+// the supply voltage now; stands in for the ADC in battery.c
+uint16_t board_vcc_mv(void);
+
+// run the firmware until 'seconds' of virtual time have passed; prints the
+// display frames (or only the last one if quiet) and never returns. exits
+// with 3 if the DS1302 bus timing was violated
+void board_run(double seconds, uint8_t quiet);
+
+// firmware entry points
+void firmware_main(void);
+void timer0_isr(void);
+void INT1_routine(void);
+
+#endif
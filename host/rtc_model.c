@@ -0,0 +1,395 @@
+// DS1302 model for the host build; see rtc_model.h
+// http://datasheets.maximintegrated.com/en/ds/DS1302.pdf
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+#include "rtc_model.h"
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+
+// datasheet minimums in ns, VCC = 2.0V
+#define T_CL    1000	// SCLK low time
+#define T_CH    1000	// SCLK high time
+#define T_DC     200	// data to SCLK setup
+#define T_CDH    280	// SCLK to data hold
+#define T_CDD    800	// SCLK to data delay (maximum; the host has to wait this long)
+#define T_CC    4000	// CE to SCLK setup
+#define T_CCH    240	// SCLK to CE hold
+#define T_CWH   4000	// CE inactive time
+
+// registers
+#define R_SECONDS  0
+#define R_MINUTES  1
+#define R_HOUR     2
+#define R_DATE     3
+#define R_MONTH    4
+#define R_DAY      5
+#define R_YEAR     6
+#define R_WP       7
+#define R_TCS      8
+#define RAM_SIZE   31
+#define BURST      31
+
+static uint8_t reg[9] = { 0x80, 0, 0, 0, 0, 0, 0, 0x80, 0x5C };	// halted, write protected
+static uint8_t ram[RAM_SIZE];
+
+// transfer state
+static uint8_t ce, sclk, io;	// pin levels last seen
+static uint16_t nbits;		// SCLK rising edges since CE went high
+static uint8_t ignore;		// rest of the transfer is ignored
+static uint8_t cmd;		// command byte, once nbits >= 8
+static uint8_t shift;		// byte being shifted in or out
+static uint8_t addr;		// register/RAM address of the next byte
+static uint8_t snap[8];		// clock registers latched at the start of a read
+static uint8_t burst[8];	// clock burst write buffer
+static uint8_t burst_n;		// bytes in burst[]
+static uint8_t sending;		// DS_IO is driven by the DS1302
+static uint8_t out;		// bit being driven
+static uint8_t latch;		// MCU's DS_IO latch, restored when the DS1302 lets go
+static uint8_t fought;		// contention already reported for this transfer
+
+// edge times, ns
+static double t_ce_rise, t_ce_fall = -1e12, t_sclk_rise, t_sclk_fall, t_io;
+
+// timekeeping
+static uint64_t t_second;	// oscillator clock of the next seconds tick
+static uint8_t ticking;
+
+static uint32_t violations;
+
+static double ns(uint64_t t)
+{
+	return t * 1e6 / SYSCLK;
+}
+
+static void check(double since, double min, const char *what, double now)
+{
+	if (now - since < min) {
+		violations++;
+		fprintf(stderr, "rtc: %s %.0f ns < %d ns at %.6f s\n",
+		        what, now - since, (int)min, now / 1e9);
+	}
+}
+
+static uint8_t bcd_inc(uint8_t *r, uint8_t mask, uint8_t first, uint8_t last)
+{
+	uint8_t v = *r & mask;
+
+	if (v == last) {
+		*r = (*r & ~mask) | first;
+		return 1;
+	}
+	v = (v & 0x0F) == 9 ? (v & 0xF0) + 0x10 : v + 1;
+	*r = (*r & ~mask) | v;
+	return 0;
+}
+
+static uint8_t days_in_month(void)
+{
+	static const uint8_t days[] = { 0x31, 0x28, 0x31, 0x30, 0x31, 0x30, 0x31, 0x31, 0x30, 0x31, 0x30, 0x31 };
+	uint8_t m = (reg[R_MONTH] >> 4) * 10 + (reg[R_MONTH] & 0x0F);
+	uint8_t y = (reg[R_YEAR] >> 4) * 10 + (reg[R_YEAR] & 0x0F);
+
+	if (m < 1 || m > 12) {
+		return 0x31;
+	}
+	return m == 2 && !(y & 3) ? 0x29 : days[m - 1];
+}
+
+// advance the clock registers by one second
+static void tick(void)
+{
+	uint8_t h;
+
+	if (!bcd_inc(&reg[R_SECONDS], 0x7F, 0x00, 0x59) || !bcd_inc(&reg[R_MINUTES], 0x7F, 0x00, 0x59)) {
+		return;
+	}
+	h = reg[R_HOUR];
+	if (h & 0x80) {
+		// 12 hour mode: 11 -> 12 flips AM/PM, 12 -> 1, a new day starts at 12 AM
+		if ((h & 0x1F) == 0x11) {
+			reg[R_HOUR] = ((h & 0xE0) ^ 0x20) | 0x12;
+			if (h & 0x20) {
+				goto new_day;
+			}
+		} else {
+			bcd_inc(&reg[R_HOUR], 0x1F, 0x01, 0x12);
+		}
+		return;
+	}
+	if (!bcd_inc(&reg[R_HOUR], 0x3F, 0x00, 0x23)) {
+		return;
+	}
+new_day:
+	bcd_inc(&reg[R_DAY], 0x07, 0x01, 0x07);
+	if (bcd_inc(&reg[R_DATE], 0x3F, 0x01, days_in_month()) && bcd_inc(&reg[R_MONTH], 0x1F, 0x01, 0x12)) {
+		bcd_inc(&reg[R_YEAR], 0xFF, 0x00, 0x99);
+	}
+}
+
+// keep time up to t; the oscillator stops while CH is set
+static void keep_time(uint64_t t)
+{
+	if (reg[R_SECONDS] & 0x80) {
+		ticking = 0;
+		return;
+	}
+	if (!ticking) {
+		ticking = 1;
+		t_second = t + SYSCLK * 1000ULL;
+	}
+	while (t >= t_second) {
+		tick();
+		t_second += SYSCLK * 1000ULL;
+	}
+}
+
+static uint8_t is_read(void) { return cmd & 1; }
+static uint8_t is_ram(void) { return cmd & 0x40; }
+static uint8_t is_burst(void) { return (cmd >> 1 & 0x1F) == BURST; }
+
+static uint8_t read_byte(void)
+{
+	if (is_ram()) {
+		return addr < RAM_SIZE ? ram[addr] : 0;
+	}
+	return addr < 8 ? snap[addr] : addr == R_TCS ? reg[R_TCS] : 0;
+}
+
+static void write_byte(uint8_t b)
+{
+	// everything but WP itself is protected while WP is set
+	if ((reg[R_WP] & 0x80) && (is_ram() || addr != R_WP)) {
+		return;
+	}
+	if (is_ram()) {
+		if (addr < RAM_SIZE) {
+			ram[addr] = b;
+		}
+	} else if (is_burst()) {
+		if (addr < 8) {
+			burst[addr] = b;
+			burst_n++;
+		}
+	} else if (addr <= R_TCS) {
+		reg[addr] = b;
+		if (addr == R_SECONDS) {
+			ticking = 0;	// writing the seconds restarts the countdown
+		}
+	}
+}
+
+// the MCU drives DS_IO: a push-pull output, or a low latch in the
+// quasi-bidirectional and open drain modes (P0M1:P0M0 bit 1)
+static uint8_t mcu_drives(void)
+{
+	uint8_t m1 = P0M1 >> 1 & 1, m0 = P0M0 >> 1 & 1;
+
+	if (m1 && !m0) {
+		return 0;	// input only
+	}
+	return !m1 && m0 ? 1 : !latch;
+}
+
+static void release(void)
+{
+	if (sending) {
+		sending = 0;
+		P0_1 = io = latch;
+	}
+}
+
+// the command and write data are sampled on SCLK rising edges
+static void sclk_rise(double now)
+{
+	if (nbits == 0) {
+		check(t_ce_rise, T_CC, "tCC CE to SCLK setup", now);
+	} else {
+		check(t_sclk_fall, T_CL, "tCL SCLK low", now);
+	}
+	if (nbits < 8 || !is_read()) {
+		check(t_io, T_DC, "tDC data to SCLK setup", now);
+	} else {
+		check(t_sclk_fall, T_CDD, "tCDD SCLK to data delay", now);
+	}
+	t_sclk_rise = now;
+
+	if (ignore) {
+		return;
+	}
+	if (nbits < 8 || !is_read()) {
+		shift = shift >> 1 | io << 7;
+	}
+	nbits++;
+	if (nbits == 8) {
+		cmd = shift;
+		addr = is_burst() ? 0 : cmd >> 1 & 0x1F;
+		if (!(cmd & 0x80)) {
+			ignore = 1;
+		} else if (is_read() && !is_ram()) {
+			memcpy(snap, reg, sizeof(snap));
+		}
+	} else if (nbits > 8 && !is_read() && (nbits & 7) == 0) {
+		write_byte(shift);
+		addr++;
+		if (!is_burst()) {
+			ignore = 1;
+		}
+	}
+}
+
+// read data goes out on SCLK falling edges, from the one ending the command
+static void sclk_fall(double now)
+{
+	uint16_t bit;
+
+	check(t_sclk_rise, T_CH, "tCH SCLK high", now);
+	t_sclk_fall = now;
+
+	if (ignore || nbits < 8 || !is_read()) {
+		return;
+	}
+	bit = nbits - 8;
+	if ((bit & 7) == 0) {
+		if (bit && !is_burst()) {
+			release();
+			ignore = 1;
+			return;
+		}
+		shift = read_byte();
+		addr++;
+	}
+	out = shift & 1;
+	shift >>= 1;
+	if (!sending) {
+		sending = 1;
+		latch = io;
+	}
+}
+
+static void ce_rise(double now)
+{
+	check(t_ce_fall, T_CWH, "tCWH CE inactive", now);
+	if (sclk) {
+		violations++;
+		fprintf(stderr, "rtc: SCLK high as CE went high at %.6f s\n", now / 1e9);
+	}
+	t_ce_rise = now;
+	nbits = 0;
+	ignore = 0;
+	shift = 0;
+	burst_n = 0;
+	fought = 0;
+}
+
+static void ce_fall(double now)
+{
+	check(t_sclk_rise, T_CCH, "tCCH SCLK to CE hold", now);
+	t_ce_fall = now;
+
+	// a clock burst write only takes effect once all 8 registers are written
+	if (nbits >= 8 && !ignore && !is_read() && !is_ram() && is_burst() && burst_n >= 8) {
+		memcpy(reg, burst, 8);
+		ticking = 0;
+	}
+	release();
+}
+
+void rtc_bus(uint64_t t)
+{
+	double now = ns(t);
+	uint8_t c = P0_0, s = P3_2, d = P0_1;
+
+	keep_time(t);
+
+	// DS_IO changes made by the MCU; tCDH only matters while it is sampled
+	if (!sending && d != io) {
+		if (ce && !ignore && (nbits < 8 || !is_read())) {
+			check(t_sclk_rise, T_CDH, "tCDH SCLK to data hold", now);
+		}
+		t_io = now;
+		io = d;
+	}
+
+	if (c != ce) {
+		ce = c;
+		if (ce) {
+			ce_rise(now);
+		} else {
+			ce_fall(now);
+		}
+	}
+	if (ce && s != sclk) {
+		if (s) {
+			sclk_rise(now);
+		} else {
+			sclk_fall(now);
+		}
+	}
+	sclk = s;
+
+	// the DS1302 drives DS_IO from the falling edge that ends a read command
+	// on; the MCU has to have let go of it by then
+	if (sending && !fought && mcu_drives()) {
+		violations++;
+		fought = 1;
+		fprintf(stderr, "rtc: DS_IO driven by both the MCU and the DS1302 at %.6f s\n", now / 1e9);
+	}
+
+	// read data is valid tCDD after the falling edge that sent it
+	if (sending && now - t_sclk_fall >= T_CDD) {
+		P0_1 = io = out;
+	}
+}
+
+int rtc_set(const char *s)
+{
+	unsigned v[6];
+	uint8_t i;
+
+	if (strlen(s) != 12 || sscanf(s, "%2x%2x%2x%2x%2x%2x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) {
+		return 0;
+	}
+	for (i = 0; i < 6; i++) {
+		if ((v[i] & 0x0F) > 9) {
+			return 0;
+		}
+	}
+	if (v[1] < 1 || v[1] > 0x12 || v[2] < 1 || v[2] > 0x31 || v[3] > 0x23 || v[4] > 0x59 || v[5] > 0x59) {
+		return 0;
+	}
+	reg[R_YEAR] = v[0];
+	reg[R_MONTH] = v[1];
+	reg[R_DATE] = v[2];
+	reg[R_HOUR] = v[3];
+	reg[R_MINUTES] = v[4];
+	reg[R_SECONDS] = v[5];
+	reg[R_DAY] = 1;
+	reg[R_WP] = 0;
+	ticking = 0;
+	return 1;
+}
+
+int rtc_ram(const char *s)
+{
+	unsigned b;
+	uint8_t i, n = strlen(s);
+
+	if (n % 2 || n > 2 * RAM_SIZE || strspn(s, "0123456789abcdefABCDEF") != n) {
+		return 0;
+	}
+	for (i = 0; i < n / 2; i++) {
+		sscanf(s + 2 * i, "%2x", &b);
+		ram[i] = b;
+	}
+	return 1;
+}
+
+uint32_t rtc_violations(void)
+{
+	return violations;
+}
@@ -0,0 +1,31 @@
+// DS1302 model for the host build
+//
+// Behaves like the DS1302 on the watch's bus (DS_CE, DS_IO, DS_SCLK): the
+// clock registers with CH and WP, 12/24 hour keeping, the 31 RAM bytes,
+// single byte and burst transfers. Every pin edge is timestamped and
+// checked against the datasheet minimums for VCC = 2.0V, and DS_IO is
+// checked for the MCU driving it while the DS1302 sends; violations are
+// reported on stderr and counted.
+//
+
+#ifndef _RTC_MODEL_H_
+#define _RTC_MODEL_H_
+
+#include <stdint.h>
+
+// sample the bus pins at time t (oscillator clocks); drives DS_IO while
+// the DS1302 is sending
+void rtc_bus(uint64_t t);
+
+// set the clock registers (BCD, 24 hour mode, running), e.g. from
+// yymmddhhmmss; returns 0 if the string is not a valid date and time
+int rtc_set(const char *yymmddhhmmss);
+
+// load the RAM from byte 0 on from a string of hex bytes, e.g. the
+// watch config; returns 0 if it is not one
+int rtc_ram(const char *hex);
+
+// timing violations seen so far
+uint32_t rtc_violations(void);
+
+#endif
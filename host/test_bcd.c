@@ -0,0 +1,75 @@
+// Host test of the packed BCD library (make test)
+//
+// bcd_add() is checked for all 65536 byte pairs against the 8051 ADD and
+// DA A as the instruction set manual describes them, and for all valid BCD
+// pairs against decimal arithmetic. The other functions are checked for
+// every valid input.
+
+#include <stdio.h>
+#include "bcd.h"
+
+static unsigned errors;
+
+static void check(const char *what, unsigned arg, unsigned got, unsigned want)
+{
+	if (got != want && errors++ < 20)
+		printf("%s(0x%04X) = 0x%02X, want 0x%02X\n", what, arg, got, want);
+}
+
+// ADD A,b then DA A, flag by flag
+static uint8_t add_da(uint8_t a, uint8_t b)
+{
+	unsigned r = a + b;
+	uint8_t ac = (a & 0x0F) + (b & 0x0F) > 0x0F;
+	uint8_t cy = r > 0xFF;
+
+	r &= 0xFF;
+	if ((r & 0x0F) > 9 || ac) {
+		r += 0x06;
+		if (r > 0xFF)
+			cy = 1;
+		r &= 0xFF;
+	}
+	if ((r & 0xF0) > 0x90 || cy)
+		r = (r + 0x60) & 0xFF;
+	return r;
+}
+
+static uint8_t bcd(unsigned n)
+{
+	return (n / 10) << 4 | n % 10;
+}
+
+int main(void)
+{
+	unsigned a, b, v, min, max, h, want;
+
+	for (a = 0; a < 256; a++)
+		for (b = 0; b < 256; b++)
+			check("bcd_add", a << 8 | b, bcd_add(a, b), add_da(a, b));
+
+	for (a = 0; a < 100; a++)
+		for (b = 0; b < 100; b++)
+			check("bcd_add", bcd(a) << 8 | bcd(b), bcd_add(bcd(a), bcd(b)), bcd((a + b) % 100));
+
+	// every value from min to max, for every range within 00..99
+	for (min = 0; min < 100; min++)
+		for (max = min; max < 100; max++)
+			for (v = min; v <= max; v++)
+				check("bcd_incr", bcd(v) << 8 | bcd(max), bcd_incr(bcd(v), bcd(min), bcd(max)),
+					v == max ? bcd(min) : bcd(v + 1));
+
+	for (v = 0; v < 100; v++) {
+		check("bcd_from_bin", v, bcd_from_bin(v), bcd(v));
+		check("bcd_to_bin", bcd(v), bcd_to_bin(bcd(v)), v);
+	}
+
+	for (h = 0; h < 24; h++) {
+		want = BCD_12H | (h >= 12 ? BCD_PM : 0) | bcd(h % 12 ? h % 12 : 12);
+		check("bcd_24to12", bcd(h), bcd_24to12(bcd(h)), want);
+		check("bcd_12to24", want, bcd_12to24(want), bcd(h));
+	}
+
+	printf("test_bcd: %u errors\n", errors);
+	return errors != 0;
+}
@@ -0,0 +1,58 @@
+// Host test of the calendar (make test)
+//
+// Checks cal_weekday() and cal_month_days() for every date from 1 January
+// 2000 to 31 December 2099 against the C library's mktime().
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cal.h"
+
+int main(void)
+{
+	struct tm tm;
+	unsigned year, month, day, days = 0, errors = 0;
+
+	for (year = 0; year < 100; year++) {
+		for (month = 1; month <= 12; month++) {
+			// day 0 of the next month is the last day of this one
+			memset(&tm, 0, sizeof tm);
+			tm.tm_year = 100 + year;
+			tm.tm_mon = month;
+			tm.tm_mday = 0;
+			tm.tm_hour = 12;
+			tm.tm_isdst = -1;
+			mktime(&tm);
+			if (cal_month_days(month, year) != tm.tm_mday) {
+				printf("cal_month_days(%u, %u) = %u, want %d\n", month, year,
+					cal_month_days(month, year), tm.tm_mday);
+				errors++;
+			}
+
+			for (day = 1; day <= (unsigned)tm.tm_mday; day++) {
+				struct tm t;
+
+				memset(&t, 0, sizeof t);
+				t.tm_year = 100 + year;
+				t.tm_mon = month - 1;
+				t.tm_mday = day;
+				t.tm_hour = 12;
+				t.tm_isdst = -1;
+				mktime(&t);
+				if (cal_weekday(day, month, year) != t.tm_wday + 1) {
+					printf("cal_weekday(%u, %u, %u) = %u, want %d\n", day, month, year,
+						cal_weekday(day, month, year), t.tm_wday + 1);
+					errors++;
+				}
+				days++;
+			}
+		}
+	}
+
+	if (days != 36525) {
+		printf("checked %u days, want 36525\n", days);
+		errors++;
+	}
+	printf("test_cal: %u days, %u errors\n", days, errors);
+	return errors != 0;
+}
@@ -0,0 +1,59 @@
+// Host build of the watch firmware (make host)
+//
+// usage: watch [-q] [-t seconds] [-d yymmddhhmmss] [-r ram] [-v mV[-mV]] [-e file] [-b] [button@down-up ...]
+//
+// Runs the firmware on the virtual board (board.c) for the given time,
+// 10 seconds by default, and prints each display frame with the time it
+// first appeared. -q prints only the last frame. -d sets the DS1302 clock
+// (24 hour mode); without it the DS1302 starts up halted and unset. -r
+// loads the DS1302 RAM with hex bytes: a55a and the 4 config bytes of
+// ds1302.h, e.g. -r a55a3a1e0000 for an alarm at 07:30. Buttons are scripted as
+// button@down-up in seconds, e.g. 1@6-6.3 holds the left button from 6s
+// to 6.3s and 2@7-9 the right one from 7s to 9s. -v sets the battery
+// voltage, e.g. -v 2400 or -v 3000-2300 for one falling over the run.
+// -e keeps the data flash in a file from run to run, and -b starts the
+// firmware up as after a low voltage reset.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "rtc_model.h"
+
+int main(int argc, char *argv[])
+{
+	double seconds = 10, down, up, vcc, vcc_end;
+	unsigned button;
+	uint8_t quiet = 0;
+	int i, n;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-q")) {
+			quiet = 1;
+		} else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "-d") && i + 1 < argc && rtc_set(argv[i + 1])) {
+			i++;
+		} else if (!strcmp(argv[i], "-r") && i + 1 < argc && rtc_ram(argv[i + 1])) {
+			i++;
+		} else if (!strcmp(argv[i], "-v") && i + 1 < argc
+		           && (n = sscanf(argv[i + 1], "%lf-%lf", &vcc, &vcc_end)) >= 1) {
+			board_vcc(vcc, n == 2 ? vcc_end : vcc);
+			i++;
+		} else if (!strcmp(argv[i], "-e") && i + 1 < argc) {
+			board_flash(argv[++i]);
+		} else if (!strcmp(argv[i], "-b")) {
+			board_brownout();
+		} else if (sscanf(argv[i], "%u@%lf-%lf", &button, &down, &up) == 3
+		           && (button == 1 || button == 2) && down < up) {
+			board_press(button, down, up);
+		} else {
+			fprintf(stderr, "usage: %s [-q] [-t seconds] [-d yymmddhhmmss] [-r ram] [-v mV[-mV]] [-e file] [-b] [button@down-up ...]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	board_run(seconds, quiet);
+	return 0;
+}
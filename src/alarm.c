@@ -0,0 +1,87 @@
+// Alarm and hourly chime; see alarm.h
+//
+
+#include "alarm.h"
+#include "ds1302.h"
+#include "pins.h"
+#include "bcd.h"
+
+// minutes register at the last check; each minute is only looked at once,
+// although the timer wakes the MCU several times in it
+uint8_t alarm_minute = 0xFF;
+
+void alarm_timer_start() {
+    if (CONF_ALARM_ON || CONF_CHIME_ON) {
+        WKTCL = ALARM_WAKE_COUNT & 0xFF;
+        WKTCH = ALARM_WAKE_COUNT >> 8 | WKTEN;
+    }
+}
+
+uint8_t alarm_check() {
+    uint8_t m, h, start, stop;
+    __bit alarm, chime;
+
+    // the DS1302 bus pins as when running; the LED anodes stay low
+    pins_set(PINS_DISPLAY_ON);
+    m = ds_readbyte(DS_ADDR_MINUTES);
+    if (m == alarm_minute) {
+        pins_set(PINS_DISPLAY_OFF);
+        return ALARM_NONE;
+    }
+    alarm_minute = m;
+    m = bcd_to_bin(m);
+
+    // the hour is only needed on the alarm minute and on the full hour
+    alarm = CONF_ALARM_ON && m == (cfg_table[CFG_ALARM_MINUTES_BYTE] & CFG_ALARM_MINUTES_MASK);
+    chime = CONF_CHIME_ON && m == 0;
+    if (!alarm && !chime) {
+        pins_set(PINS_DISPLAY_OFF);
+        return ALARM_NONE;
+    }
+    h = ds_readbyte(DS_ADDR_HOUR);
+    pins_set(PINS_DISPLAY_OFF);
+    if (h & DS_MASK_AMPM_MODE)
+        h = bcd_12to24(h);
+    h = bcd_to_bin(h);
+
+    if (alarm && h == cfg_table[CFG_ALARM_HOURS_BYTE] >> CFG_ALARM_HOURS_SHIFT)
+        return ALARM_FIRE;
+
+    // chime hours run from start to stop, possibly across midnight
+    if (chime) {
+        start = cfg_table[CFG_CHIME_START_BYTE] >> CFG_CHIME_START_SHIFT;
+        stop = cfg_table[CFG_CHIME_STOP_BYTE] & CFG_CHIME_STOP_MASK;
+        if (start <= stop ? h >= start && h <= stop : h >= start || h <= stop)
+            return ALARM_CHIME;
+    }
+    return ALARM_NONE;
+}
+
+void alarm_hour_incr() {
+    uint8_t h = (cfg_table[CFG_ALARM_HOURS_BYTE] >> CFG_ALARM_HOURS_SHIFT) + 1;
+
+    if (h > 23)
+        h = 0;
+    cfg_table[CFG_ALARM_HOURS_BYTE] = (cfg_table[CFG_ALARM_HOURS_BYTE] & ~CFG_ALARM_HOURS_MASK) | h << CFG_ALARM_HOURS_SHIFT;
+    ds_ram_config_write();
+}
+
+void alarm_minute_incr() {
+    uint8_t m = (cfg_table[CFG_ALARM_MINUTES_BYTE] & CFG_ALARM_MINUTES_MASK) + 1;
+
+    if (m > 59)
+        m = 0;
+    cfg_table[CFG_ALARM_MINUTES_BYTE] = (cfg_table[CFG_ALARM_MINUTES_BYTE] & ~CFG_ALARM_MINUTES_MASK) | m;
+    ds_ram_config_write();
+}
+
+#if CONF_ALARM_ON_MASK != 1 << ALARM_ON_SHIFT || CONF_CHIME_ON_BYTE != CONF_ALARM_ON_BYTE || CONF_CHIME_ON_MASK != CONF_ALARM_ON_MASK << 1
+#error "CONF_ALARM_ON and CONF_CHIME_ON have to be bits ALARM_ON_SHIFT and ALARM_ON_SHIFT + 1 of a byte"
+#endif
+
+void alarm_on_next() {
+    uint8_t b = cfg_table[CONF_ALARM_ON_BYTE];
+
+    cfg_table[CONF_ALARM_ON_BYTE] = (b & ~ALARM_ON_BITS) | ((b + CONF_ALARM_ON_MASK) & ALARM_ON_BITS);
+    ds_ram_config_write();
+}
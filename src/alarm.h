@@ -0,0 +1,46 @@
+// Alarm and hourly chime, checked while the MCU is in power down
+//
+// The power down wake-up timer wakes the MCU every ALARM_WAKE_COUNT with
+// the alarm or chime on. alarm_check() then reads the minutes from the
+// DS1302 and, only when a new minute is one that matters, the hour. The
+// MCU goes straight back to sleep unless something is due.
+//
+
+#include "hal.h"
+#include <stdint.h>
+
+// WKTCH:WKTCL is a 15 bit count of the internal ~32kHz low power
+// oscillator divided by 16, i.e. about 488uS per count; the period is
+// (count + 1) counts. it must stay below a minute so no minute is missed.
+#define WKTEN             0x80	// WKTCH: wake-up timer enable
+#define ALARM_WAKE_COUNT  0x7FFF	// about 16s, the longest
+
+// results of alarm_check()
+#define ALARM_NONE   0
+#define ALARM_CHIME  1	// chime on, a full hour inside the chime hours
+#define ALARM_FIRE   2	// alarm on, the alarm time
+
+// start the wake-up timer for the next power down if the alarm or chime is on
+void alarm_timer_start();
+
+// stop it again once the display is back on
+#define alarm_timer_stop()  (WKTCH = 0)
+
+// check the clock after a wake-up timer wake; expects the pins in their
+// power down state and leaves them that way
+uint8_t alarm_check();
+
+// setting the alarm (K_SET_ALARM_ modes in main.c). each step is saved to
+// the DS1302 RAM config right away, like the brightness.
+
+// step the alarm hour (0-23) or minute (0-59) up by one, wrapping around
+void alarm_hour_incr();
+void alarm_minute_incr();
+
+// step CONF_ALARM_ON and CONF_CHIME_ON through off, alarm, chime, both
+void alarm_on_next();
+
+// the two bits as that 2 bit number, 0-3
+#define ALARM_ON_SHIFT  1
+#define ALARM_ON_BITS   (CONF_ALARM_ON_MASK | CONF_CHIME_ON_MASK)
+#define alarm_on()      ((cfg_table[CONF_ALARM_ON_BYTE] & ALARM_ON_BITS) >> ALARM_ON_SHIFT)
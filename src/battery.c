@@ -0,0 +1,74 @@
+// Battery monitor; see battery.h
+//
+
+#include "battery.h"
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+
+// ADC_CONTR
+#define ADC_POWER  0x80
+#define ADC_FLAG   0x10
+#define ADC_START  0x08	// speed bits 00: 540 clocks per conversion
+
+// ADC power up time, about 1ms
+#define BATTERY_SETTLE_CLOCKS  SYSCLK
+
+const uint16_t battery_counts[BATTERY_LEVELS - 1] = {
+    BATTERY_COUNTS(BATTERY_LOW_MV),
+    BATTERY_COUNTS(BATTERY_LOWER_MV),
+    BATTERY_COUNTS(BATTERY_CRITICAL_MV)
+};
+
+const uint8_t battery_dim[BATTERY_LEVELS]          = { 0, 0, 3, 6 };
+const uint8_t battery_show_seconds[BATTERY_LEVELS] = { 5, 5, 3, 2 };
+
+uint8_t battery_level = 0;
+
+#ifdef __SDCC
+
+uint16_t battery_read() {
+    uint16_t i;
+
+    P1ASF = 0;
+    ADC_CONTR = ADC_POWER;
+    // about 8 clocks a pass
+    for (i = BATTERY_SETTLE_CLOCKS / 8; i; i--)
+        hal_nop();
+    ADC_CONTR = ADC_POWER | ADC_START;
+    // ADC_FLAG is valid 4 clocks after ADC_START
+    hal_nop();
+    hal_nop();
+    hal_nop();
+    hal_nop();
+    // bounded, so a simulator without an ADC reads 0 (a good battery)
+    i = 0;
+    while (!(ADC_CONTR & ADC_FLAG)) {
+        if (!--i) {
+            // power the ADC down on this path too; it would draw in power down
+            ADC_CONTR = 0;
+            return 0;
+        }
+    }
+    ADC_CONTR = 0;
+    return ADC_RES << 2 | (ADC_RESL & 0x03);
+}
+
+#else
+
+// host build: the board supplies VCC
+uint16_t battery_read() {
+    board_cycles(BATTERY_SETTLE_CLOCKS);
+    return BATTERY_COUNTS(board_vcc_mv());
+}
+
+#endif
+
+void battery_check() {
+    uint16_t c = battery_read();
+
+    battery_level = 0;
+    while (battery_level < BATTERY_LEVELS - 1 && c > battery_counts[battery_level])
+        battery_level++;
+}
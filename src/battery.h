@@ -0,0 +1,39 @@
+// Battery (VCC) monitor and low battery power policy
+//
+// The ADC measures the internal bandgap reference against VCC: with no P1
+// pin set up as an analog input (P1ASF = 0), channel 0 is the bandgap.
+// The lower VCC, the higher the result, so the thresholds are kept as ADC
+// counts and nothing is divided at run time. No P1 pin is used, but the
+// measurement is still taken with the display dark, so the LED current
+// does not pull VCC down while it runs.
+//
+
+#include "hal.h"
+#include <stdint.h>
+
+// nominal bandgap voltage; calibrate against a measured VCC if needed
+#ifndef BATTERY_BANDGAP_MV
+#define BATTERY_BANDGAP_MV  1250
+#endif
+
+// ADC counts (10 bit) for a VCC in mV
+#define BATTERY_COUNTS(mv)  ((1UL * BATTERY_BANDGAP_MV * 1024 + (mv) / 2) / (mv))
+
+// level 0 is a good battery; each threshold VCC drops below adds one
+#define BATTERY_LEVELS  4
+#define BATTERY_LOW_MV      2700	// low battery indicator from here on
+#define BATTERY_LOWER_MV    2500
+#define BATTERY_CRITICAL_MV 2350
+
+extern uint8_t battery_level;
+
+// per level: the brightest brightness level allowed (0 = brightest) and
+// how long the display stays on
+extern const uint8_t battery_dim[BATTERY_LEVELS];
+extern const uint8_t battery_show_seconds[BATTERY_LEVELS];
+
+// raw ADC counts of the bandgap; about 1ms, most of it ADC power up
+uint16_t battery_read();
+
+// measure and update battery_level
+void battery_check();
@@ -0,0 +1,85 @@
+// Packed BCD arithmetic; see bcd.h
+//
+
+#include "bcd.h"
+
+#ifdef __SDCC
+
+uint8_t bcd_add(uint8_t a, uint8_t b)
+{
+	a; b;
+	__asm
+		mov		a,dpl
+		add		a,_bcd_add_PARM_2
+		da		a
+		mov		dpl,a
+	__endasm;
+}
+
+#else
+
+// host build: what DA A does after the ADD
+uint8_t bcd_add(uint8_t a, uint8_t b)
+{
+	uint16_t r = a + b;
+
+	if ((a & 0x0F) + (b & 0x0F) > 9)
+		r += 0x06;
+	if (r > 0x9F)
+		r += 0x60;
+	return r;
+}
+
+#endif
+
+uint8_t bcd_incr(uint8_t v, uint8_t min, uint8_t max)
+{
+	if (v >= max)
+		return min;
+	return bcd_add(v, 1);
+}
+
+// shift the bits of n in from the top, doubling the BCD result for each.
+// a doubled BCD number ends in an even digit, so the new bit can be ORed in.
+uint8_t bcd_from_bin(uint8_t n)
+{
+	uint8_t i, r = 0;
+
+	for (i = 8; i; i--) {
+		r = bcd_add(r, r) | (n >> 7);
+		n <<= 1;
+	}
+	return r;
+}
+
+// 16 * tens + ones - 6 * tens
+uint8_t bcd_to_bin(uint8_t v)
+{
+	uint8_t t = v >> 4;
+
+	return v - (t << 2) - (t << 1);
+}
+
+uint8_t bcd_24to12(uint8_t h)
+{
+	uint8_t r = BCD_12H;
+
+	if (h >= 0x12) {
+		r |= BCD_PM;
+		h = bcd_add(h, 0x88);	// - 12, mod 100
+	}
+	if (h == 0)
+		h = 0x12;
+	return r | h;
+}
+
+uint8_t bcd_12to24(uint8_t h)
+{
+	uint8_t r = h & 0x1F;
+
+	if (r == 0x12)
+		r = 0;
+	if (h & BCD_PM)
+		r = bcd_add(r, 0x12);
+	return r;
+}
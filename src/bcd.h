@@ -0,0 +1,29 @@
+// Packed BCD arithmetic
+//
+// The DS1302 keeps the time as packed BCD, two decimal digits per byte.
+// These work on it directly: bcd_add() is an 8051 ADD + DA A, and
+// nothing here goes through the compiler's division or multiply helpers.
+// Packed BCD values compare like plain bytes, so <, >= etc. just work.
+//
+
+#pragma callee_saves bcd_add
+
+#include <stdint.h>
+
+// 12 hour values as the DS1302 stores them: 12h mode flag, PM flag, 01-12
+#define BCD_12H  0x80
+#define BCD_PM   0x20
+
+// a + b, both 00-99; the carry out of the tens is dropped
+uint8_t bcd_add(uint8_t a, uint8_t b);
+
+// v + 1, or min once v has reached max
+uint8_t bcd_incr(uint8_t v, uint8_t min, uint8_t max);
+
+// binary 0-99 to BCD and back
+uint8_t bcd_from_bin(uint8_t n);
+uint8_t bcd_to_bin(uint8_t v);
+
+// hours 00-23 to BCD_12H | BCD_PM | 01-12, and back
+uint8_t bcd_24to12(uint8_t h);
+uint8_t bcd_12to24(uint8_t h);
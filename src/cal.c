@@ -0,0 +1,40 @@
+// Calendar for 2000-2099; see cal.h
+//
+
+#include "cal.h"
+
+const uint8_t cal_month_len[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+// days from 1 January to the 1st of each month of a common year, mod 7
+const uint8_t cal_month_offset[12] = { 0, 3, 3, 6, 1, 4, 6, 2, 5, 0, 3, 5 };
+
+uint8_t cal_month_days(uint8_t month, uint8_t year) {
+    month--;
+    if (month >= 12)
+        return 31;
+    if (month == 1 && cal_leap(year))
+        return 29;
+    return cal_month_len[month];
+}
+
+uint8_t cal_weekday(uint8_t day, uint8_t month, uint8_t year) {
+    uint8_t n;
+
+    month--;
+    if (month >= 12)
+        month = 0;
+
+    // days since Saturday 1 January 2000, mod 7: a year is 365 = 1 mod 7
+    // days, plus one for each leap year before this one. at most 167.
+    n = year + ((year + 3) >> 2) + cal_month_offset[month] + day + 5;
+    if (month >= 2 && cal_leap(year))
+        n++;
+
+    // n mod 7 without a division: 8 = 1 mod 7, so the digits of n in base
+    // 8 add up to the same remainder. two rounds take 167 down to 10 or less.
+    n = (n >> 3) + (n & 7);
+    n = (n >> 3) + (n & 7);
+    if (n >= 7)
+        n -= 7;
+    return n + 1;
+}
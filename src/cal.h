@@ -0,0 +1,16 @@
+// Calendar for 2000-2099, the range of the DS1302's 2 digit year
+//
+// Every year divisible by 4 is a leap year in this range, so the rules
+// reduce to small constant tables; nothing here divides.
+// Arguments are binary: day 1-31, month 1-12, year 0-99.
+//
+
+#include <stdint.h>
+
+#define cal_leap(year)  (!((year) & 3))
+
+// days in the month; 31 for an invalid month
+uint8_t cal_month_days(uint8_t month, uint8_t year);
+
+// day of the week, 1 = Sunday as on the DS1302
+uint8_t cal_weekday(uint8_t day, uint8_t month, uint8_t year);
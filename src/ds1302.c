@@ -2,41 +2,85 @@
 // http://datasheets.maximintegrated.com/en/ds/DS1302.pdf
 //
 
-#pragma callee_saves sendbyte,readbyte
-#pragma callee_saves ds_writebyte,ds_readbyte
+#pragma callee_saves sendbyte,readbyte,sendcmd
+#pragma callee_saves ds_writebyte,ds_readbyte,ds_begin,ds_ce_delay
 
 #include "ds1302.h"
+#include "cal.h"
+#include "bcd.h"
 
 #define MAGIC_HI  0x5A
 #define MAGIC_LO  0xA5
 
-void ds_ram_config_init() {
-    uint8_t i,j;
-    // check magic bytes to see if ram has been written before
-    if ( (ds_readbyte( DS_CMD_RAM >> 1 | 0x00) != MAGIC_LO || ds_readbyte( DS_CMD_RAM >> 1 | 0x01) != MAGIC_HI) ) {
-        // if not, must init ram config to defaults
-        ds_writebyte( DS_CMD_RAM >> 1 | 0x00, MAGIC_LO);
-        ds_writebyte( DS_CMD_RAM >> 1 | 0x01, MAGIC_HI);
-
-	ds_ram_config_write();	// OPTIMISE : Will generate a ljmp to ds_ram_config_write
-	return;
-    }
-    
-    // read ram config
-    // OPTIMISE : end condition of loop !=4 will generate less code than <4 
-    // OPTIMISE : was cfg_table[i] = ds_readbyte(DS_CMD_RAM >> 1 | (i+2));
-    //            using a second variable instead of DS_CMD_RAM>>1 | (i+2) generates less code
-    j=DS_CMD_RAM>>1|2;
-    for (i=0; i!=4; i++)
-        cfg_table[i] = ds_readbyte(j++);
-}
+// chime hours of a fresh config, 08:00 to 22:00
+#define CHIME_START  8
+#define CHIME_STOP   22
 
-void ds_ram_config_write() {
-    uint8_t i,j;
-    j=DS_CMD_RAM>>1|2;
-    for (i=0; i!=4; i++)
-        ds_writebyte( j++, cfg_table[i]);
-}
+// bus timing
+//
+// The bit loops below are padded with nops so the DS1302 datasheet minimums
+// hold at VCC = 2.0V, the end of a CR2032's life. The pad counts are worked
+// out at compile time from SYSCLK (kHz, passed in by the Makefile) and the
+// STC15 instruction timings, so a different clock rebuilds with the right
+// delays. The bus is only driven with the CPU at full clock (clk_fast() in
+// main.c); define DS_CLK_DIV if that ever changes.
+//
+// At 11.0592MHz the djnz of the bit loop is hidden in the SCLK low time, so
+// unrolling the loops would only trade it for nops.
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+#ifndef DS_CLK_DIV
+#define DS_CLK_DIV 0
+#endif
+
+// datasheet minimums in ns (2.0V column)
+#ifndef DS_T_CL
+#define DS_T_CL   1000    // tCL, SCLK low time
+#endif
+#ifndef DS_T_CH
+#define DS_T_CH   1000    // tCH, SCLK high time
+#endif
+#ifndef DS_T_DC
+#define DS_T_DC    200    // tDC, data to SCLK setup
+#endif
+#ifndef DS_T_CDD
+#define DS_T_CDD   800    // tCDD, SCLK to data delay
+#endif
+#ifndef DS_T_CC
+#define DS_T_CC   4000    // tCC, CE to SCLK setup; also tCWH, CE inactive time
+#endif
+
+// STC15 instruction clocks, counted up to the pin change / sample
+#define CLK_MOV_BIT_C  3    // mov bit,c
+#define CLK_MOV_C_BIT  2    // mov c,bit
+#define CLK_SETB_CLR   3    // setb bit / clr bit
+#define CLK_RRC        1
+#define CLK_DJNZ       4
+#define CLK_CALL      10    // lcall + ret
+#define CLK_CJNE       4
+
+// clocks to cover ns, rounded up
+#define DS_CLOCKS(ns)  ((1UL * (ns) * (SYSCLK >> DS_CLK_DIV) + 999999UL) / 1000000UL)
+#define DS_PAD(clk, used)  ((clk) > (used) ? (clk) - (used) : 0)
+
+// sendbyte: data -> setup pad -> SCLK high -> high pad -> SCLK low -> djnz -> low pad
+#define DS_W_SETUP  DS_PAD(DS_CLOCKS(DS_T_DC), CLK_SETB_CLR)
+#define DS_W_HIGH   DS_PAD(DS_CLOCKS(DS_T_CH), CLK_SETB_CLR)
+#define DS_W_LOW    DS_PAD(DS_CLOCKS(DS_T_CL), CLK_DJNZ + CLK_RRC + CLK_MOV_BIT_C + DS_W_SETUP + CLK_SETB_CLR)
+
+// readbyte: SCLK low -> djnz -> low pad -> sample -> SCLK high -> high pad;
+// the sample is counted from the start of mov c,bit
+#define DS_R_CDD    DS_PAD(DS_CLOCKS(DS_T_CDD), CLK_DJNZ)
+#define DS_R_CL     DS_PAD(DS_CLOCKS(DS_T_CL), CLK_DJNZ + CLK_MOV_C_BIT + CLK_RRC + CLK_SETB_CLR)
+#define DS_R_LOW    (DS_R_CDD > DS_R_CL ? DS_R_CDD : DS_R_CL)
+#define DS_R_HIGH   DS_W_HIGH
+
+// CE setup/inactive delay, in 4 clock loop passes
+#define DS_CE_LOOPS ((DS_CLOCKS(DS_T_CC) + 3) / 4)
+
+#ifdef __SDCC
 
 // NOTE: DS_IO and DS_SCLK are hard-coded here
 //       does it have to be?
@@ -48,13 +92,15 @@ void sendbyte(uint8_t b)
 		mov		a,dpl
 		mov		r7,#8
 		00001$:
-			nop
-			nop
+#define DS_NOPS DS_W_LOW
+#include "ds1302_nops.h"
 			rrc		a
 			mov		_P0_1,c
+#define DS_NOPS DS_W_SETUP
+#include "ds1302_nops.h"
 			setb	_P3_2
-			nop
-			nop
+#define DS_NOPS DS_W_HIGH
+#include "ds1302_nops.h"
 			clr		_P3_2
 			djnz	r7, 00001$
 		pop	ar7
@@ -70,13 +116,13 @@ uint8_t readbyte()
 		mov		a,#0
 		mov 	r7,#8
 		00002$:
-			nop
-			nop
+#define DS_NOPS DS_R_LOW
+#include "ds1302_nops.h"
 			mov		c, _P0_1
 			rrc		a	
 			setb	_P3_2
-			nop
-			nop
+#define DS_NOPS DS_R_HIGH
+#include "ds1302_nops.h"
 			clr		_P3_2
 			djnz	r7, 00002$
 			mov		dpl, a
@@ -84,49 +130,230 @@ uint8_t readbyte()
 	__endasm;
 }
 
-uint8_t ds_readbyte(uint8_t addr) {
-    // ds1302 single-byte read
-    uint8_t b;
-    b = DS_CMD | DS_CMD_CLOCK | addr << 1 | DS_CMD_READ;
+#ifdef DS_PUSHPULL
+// sendbyte for a command byte: for a read, DS_IO is switched to an input
+// (ds_io_input()) after the last bit has been clocked in, before SCLK falls.
+// the DS1302 starts driving its first data bit on that falling edge.
+void sendcmd(uint8_t cmd)
+{
+	cmd;
+	__asm
+		push	ar7
+		mov		a,dpl
+		mov		r7,#8
+		00003$:
+#define DS_NOPS DS_W_LOW
+#include "ds1302_nops.h"
+			rrc		a
+			mov		_P0_1,c
+#define DS_NOPS DS_W_SETUP
+#include "ds1302_nops.h"
+			setb	_P3_2
+#define DS_NOPS DS_W_HIGH
+#include "ds1302_nops.h"
+			cjne	r7,#1,00004$
+			mov		a,dpl
+			jnb		acc.0,00004$
+			anl		_P0M0,#0xFD
+			orl		_P0M1,#0x02
+		00004$:
+			clr		_P3_2
+			djnz	r7, 00003$
+		pop	ar7
+	__endasm;
+}
+#endif
+
+#else
+
+// host build: the same bit loops, spending the clocks the assembly
+// versions take (see bus timing above) on the virtual board
+void sendbyte(uint8_t b)
+{
+	uint8_t i;
+
+	board_cycles(CLK_CALL + 9);	// push/pop ar7, mov a,dpl, mov r7
+	for (i = 0; i < 8; i++) {
+		board_cycles(DS_W_LOW + CLK_RRC + CLK_MOV_BIT_C);
+		DS_IO = b & 1;
+		b >>= 1;
+		board_cycles(DS_W_SETUP + CLK_SETB_CLR);
+		DS_SCLK = 1;
+		board_cycles(DS_W_HIGH + CLK_SETB_CLR);
+		DS_SCLK = 0;
+		board_cycles(CLK_DJNZ);
+	}
+}
+
+uint8_t readbyte()
+{
+	uint8_t i, b = 0;
+
+	board_cycles(CLK_CALL + 11);	// push/pop ar7, mov a, mov r7, mov dpl
+	for (i = 0; i < 8; i++) {
+		board_cycles(DS_R_LOW);
+		b = (b >> 1) | (DS_IO << 7);
+		board_cycles(CLK_MOV_C_BIT + CLK_RRC + CLK_SETB_CLR);
+		DS_SCLK = 1;
+		board_cycles(DS_R_HIGH + CLK_SETB_CLR);
+		DS_SCLK = 0;
+		board_cycles(CLK_DJNZ);
+	}
+	return b;
+}
+
+#ifdef DS_PUSHPULL
+void sendcmd(uint8_t cmd)
+{
+	uint8_t i;
+
+	board_cycles(CLK_CALL + 9);
+	for (i = 0; i < 8; i++) {
+		board_cycles(DS_W_LOW + CLK_RRC + CLK_MOV_BIT_C);
+		DS_IO = cmd >> i & 1;
+		board_cycles(DS_W_SETUP + CLK_SETB_CLR);
+		DS_SCLK = 1;
+		board_cycles(DS_W_HIGH + CLK_CJNE);
+		if (i == 7 && (cmd & DS_CMD_READ)) {
+			board_cycles(3 + 4 + 4);	// mov a,dpl; jnb; anl
+			ds_io_input();
+			board_cycles(4);		// orl
+		}
+		board_cycles(CLK_SETB_CLR);
+		DS_SCLK = 0;
+		board_cycles(CLK_DJNZ);
+	}
+}
+#endif
+
+#endif
+
+// the stock board's pull-up lets the DS1302 pull DS_IO down over the
+// high latch, so a command is sent like any other byte
+#ifndef DS_PUSHPULL
+#define sendcmd(cmd)  sendbyte(cmd)
+#endif
+
+// hold CE for tCWH / tCC
+void ds_ce_delay() {
+#ifdef __SDCC
+    uint8_t i = DS_CE_LOOPS;
+    do {
+        __asm nop __endasm;
+    } while (--i);
+#else
+    board_cycles(CLK_CALL + 2 + DS_CE_LOOPS * 4);
+#endif
+}
+
+void ds_begin(uint8_t cmd) {
     DS_CE = 0;
     DS_SCLK = 0;
+    ds_ce_delay();
     DS_CE = 1;
-    // send cmd byte
-    sendbyte(b);
-    // read byte
+    ds_ce_delay();
+    sendcmd(cmd);
+}
+
+uint8_t ds_readbyte(uint8_t addr) {
+    // ds1302 single-byte read
+    uint8_t b;
+    ds_begin(DS_CMD | DS_CMD_CLOCK | addr << 1 | DS_CMD_READ);
+    // read byte; ds_begin() has let go of DS_IO
     b=readbyte();
     DS_CE = 0;
+    ds_io_output();
     return b;
 }
 
-void ds_readburst() {
-    // ds1302 burst-read 8 bytes into struct
-    uint8_t j, b;
-    b = DS_CMD | DS_CMD_CLOCK | DS_BURST_MODE << 1 | DS_CMD_READ;
+void ds_burst_read(uint8_t cmd, __data uint8_t *buf, uint8_t len) {
+    ds_begin(cmd | DS_CMD_READ);
+    for (; len; len--)
+        *buf++ = readbyte();
     DS_CE = 0;
-    DS_SCLK = 0;
-    DS_CE = 1;
-    // send cmd byte
-    sendbyte(b);
-    // read bytes
-    for (j=0; j!=8; j++) 
-        rtc_table[j] = readbyte();
+    ds_io_output();
+}
+
+void ds_burst_write(uint8_t cmd, __data uint8_t *buf, uint8_t len) {
+    ds_begin(cmd | DS_CMD_WRITE);
+    for (; len; len--)
+        sendbyte(*buf++);
     DS_CE = 0;
+    ds_io_release();
+}
+
+__bit ds_updated = 0;
+
+// config lives in DS1302 RAM bytes 2..5, behind two magic bytes.
+// both functions move all 6 bytes in a single RAM burst transfer.
+void ds_ram_config_init() {
+    uint8_t i, lo, hi;
+    ds_begin(DS_BURST_RAM | DS_CMD_READ);
+    lo = readbyte();
+    hi = readbyte();
+    for (i=0; i!=4; i++)
+        cfg_table[i] = readbyte();
+    DS_CE = 0;
+    ds_io_output();
+
+    // check magic bytes to see if ram has been written before
+    if (lo != MAGIC_LO || hi != MAGIC_HI) {
+        // if not, must init ram config to defaults
+        cfg_table[0] = cfg_table[1] = cfg_table[2] = cfg_table[3] = 0;
+        cfg_table[CFG_CHIME_START_BYTE] |= CHIME_START << CFG_CHIME_START_SHIFT;
+        cfg_table[CFG_CHIME_STOP_BYTE] |= CHIME_STOP << CFG_CHIME_STOP_SHIFT;
+        ds_ram_config_write();	// OPTIMISE : Will generate a ljmp to ds_ram_config_write
+    }
+}
+
+void ds_ram_config_write() {
+    uint8_t i;
+    ds_begin(DS_BURST_RAM | DS_CMD_WRITE);
+    sendbyte(MAGIC_LO);
+    sendbyte(MAGIC_HI);
+    for (i=0; i!=4; i++)
+        sendbyte(cfg_table[i]);
+    DS_CE = 0;
+    ds_io_release();
+}
+
+void ds_readburst() {
+    // ds1302 burst-read 8 bytes into struct
+    ds_burst_read(DS_BURST_CLOCK, rtc_table, 8);
+    ds_updated = 1;
+}
+
+uint8_t ds_phase = 0;
+
+void ds_sync() {
+    ds_readburst();
+    // the edge could be anywhere in the next second; poll for it from the next tick on
+    ds_phase = DS_TICKS_PER_SECOND - 1;
+}
+
+void ds_tick() {
+    // rtc_table holds edits that are not written back yet
+    if (ds_dirty)
+        return;
+    if (ds_phase != DS_TICKS_PER_SECOND - 1) {
+        ds_phase++;
+        return;
+    }
+    // seconds edge is due; a single register read tells whether it has passed yet.
+    // if not, keep polling on the following ticks.
+    if (ds_readbyte(DS_ADDR_SECONDS) == rtc_table[DS_ADDR_SECONDS])
+        return;
+    ds_readburst();
+    ds_phase = 0;
 }
 
 void ds_writebyte(uint8_t addr, uint8_t data) {
     // ds1302 single-byte write
-    uint8_t b = 0;
-    b = DS_CMD | DS_CMD_CLOCK | addr << 1 | DS_CMD_WRITE;
-    DS_CE = 0;
-    DS_SCLK = 0;
-    DS_CE = 1;
-    // send cmd byte
-    sendbyte(b);
+    ds_begin(DS_CMD | DS_CMD_CLOCK | addr << 1 | DS_CMD_WRITE);
     // send data byte
     sendbyte(data);
-
     DS_CE = 0;
+    ds_io_release();
 }
 
 void ds_init() {
@@ -144,104 +371,123 @@ void ds_halt() {
 }
 
 // reset date, time
+// all clock registers are written in one clock burst, which has to cover
+// the first 8 registers; seconds and year are kept, CH and WP cleared.
 void ds_reset_clock() {
-    ds_writebyte(DS_ADDR_MINUTES, 0x00);
-    ds_writebyte(DS_ADDR_HOUR,  DS_MASK_AMPM_MODE|0x07);
-    ds_writebyte(DS_ADDR_MONTH, 0x01);
-    ds_writebyte(DS_ADDR_DAY,   0x01);
-	ds_set_day_of_week();
+    rtc_table[DS_ADDR_SECONDS] &= DS_MASK_SECONDS;
+    rtc_table[DS_ADDR_MINUTES] = 0x00;
+    rtc_table[DS_ADDR_HOUR] = DS_MASK_AMPM_MODE|0x07;
+    rtc_table[DS_ADDR_MONTH] = 0x01;
+    rtc_table[DS_ADDR_DAY] = 0x01;
+    ds_date_fix();
+    rtc_table[DS_ADDR_WP] = 0;
+    ds_burst_write(DS_BURST_CLOCK, rtc_table, 8);
+    ds_sync();
 }
     
-void ds_hours_12_24_toggle() {
+uint8_t ds_dirty = 0;
 
-    uint8_t hours,b;
+// the 12/24 hour mode was toggled; WP is never edited, so its bit is free
+#define DS_DIRTY_MODE  (1 << DS_ADDR_WP)
+#define DS_DIRTY_DATE  (1 << DS_ADDR_DAY | 1 << DS_ADDR_MONTH | 1 << DS_ADDR_YEAR)
+
+void ds_hours_12_24_toggle() {
     if (H12_24)
-    { // 12h->24h
-      hours=ds_split2int(rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR12); // hours in 12h format (1-11am 12pm 1-11pm 12am)
-      if (hours==12) 
-       {if (!H12_PM) hours=0;}
-      else
-       {if (H12_PM) hours+=12;}			 // to 24h format
-      b = ds_int2bcd(hours);			 // clear hour_12_24 bit
-    }
+        rtc_table[DS_ADDR_HOUR] = bcd_12to24(rtc_table[DS_ADDR_HOUR]);
     else
-    { // 24h->12h 
-      hours = ds_split2int(rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR24); // hours in 24h format (0-23, 0-11=>am , 12-23=>pm)
-      b = DS_MASK_AMPM_MODE; 
-      if (hours >= 12) { hours-=12; b|=0x20; }	// pm
-      if (hours == 0) { hours=12; } 		//12am
-      b |= ds_int2bcd(hours);
-    }
-
-    ds_writebyte(DS_ADDR_HOUR,b);
+        rtc_table[DS_ADDR_HOUR] = bcd_24to12(rtc_table[DS_ADDR_HOUR] & DS_MASK_HOUR24);
+    ds_dirty |= DS_DIRTY_MODE;
 }
 
-// increment hours
-void ds_hours_incr() {
-    uint8_t hours, b = 0;
-    if (!H12_24) {
-        hours = ds_split2int(rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR24);	//24h format
-        if (hours < 23)
-            hours++;
-        else {
-            hours = 00;
-        }
-        b = ds_int2bcd(hours);		// bit 7 = 0
-    } else {
-        hours = ds_split2int(rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR12);	//12h format
-        if (hours < 12)
-            hours++;
-        else {
-            hours = 1;
-            H12_PM=!H12_PM;
-        }
-        b = (H12_PM?(DS_MASK_AMPM_MODE|DS_MASK_PM):DS_MASK_AMPM_MODE) | ds_int2bcd(hours);        
-    }
-    
-    ds_writebyte(DS_ADDR_HOUR, b);
+// editable clock fields, one row per DS_FIELD_ (see ds1302.h): the
+// register, the bits of it holding the BCD value and its range in BCD
+// (DS_FF_MDAY rows end at the length of the month instead)
+const uint8_t ds_field_addr[] = { DS_ADDR_HOUR, DS_ADDR_HOUR, DS_ADDR_MINUTES, DS_ADDR_DAY, DS_ADDR_MONTH, DS_ADDR_YEAR };
+const uint8_t ds_field_mask[] = { DS_MASK_HOUR24, DS_MASK_HOUR12, DS_MASK_MINUTES, DS_MASK_DAY, DS_MASK_MONTH, DS_MASK_YEAR };
+const uint8_t ds_field_min[]  = { 0x00, 0x01, 0x00, 0x01, 0x01, 0x00 };
+const uint8_t ds_field_max[]  = { 0x23, 0x12, 0x59, 0x31, 0x12, 0x99 };
+
+#define DS_FF_12H   0x01	// in 12h mode the next row is used instead
+#define DS_FF_PM    0x02	// wrapping around toggles AM/PM
+#define DS_FF_DATE  0x04	// a date field; see ds_date_fix()
+#define DS_FF_MDAY  0x08	// the range ends at the length of the month
+const uint8_t ds_field_flags[] = { DS_FF_12H, DS_FF_PM, 0, DS_FF_DATE | DS_FF_MDAY, DS_FF_DATE, DS_FF_DATE };
+
+// length of the month in rtc_table, in BCD
+static uint8_t ds_month_days() {
+    return bcd_from_bin(cal_month_days(bcd_to_bin(rtc_table[DS_ADDR_MONTH] & DS_MASK_MONTH),
+                                       bcd_to_bin(rtc_table[DS_ADDR_YEAR])));
 }
 
-// increment minutes
-void ds_minutes_incr() {
-    uint8_t minutes = ds_split2int(rtc_table[DS_ADDR_MINUTES]&DS_MASK_MINUTES);
-    if (minutes < 59)
-        minutes++;
-    else
-        minutes = 1;
-    ds_writebyte(DS_ADDR_MINUTES, ds_int2bcd(minutes));
+// keep the date in rtc_table valid: pull the day back into the month and
+// set the weekday to match
+void ds_date_fix() {
+    uint8_t max = ds_month_days();
+    if ((rtc_table[DS_ADDR_DAY] & DS_MASK_DAY) > max)
+        rtc_table[DS_ADDR_DAY] = max;
+    rtc_table[DS_ADDR_WEEKDAY] = cal_weekday(bcd_to_bin(rtc_table[DS_ADDR_DAY] & DS_MASK_DAY),
+                                             bcd_to_bin(rtc_table[DS_ADDR_MONTH] & DS_MASK_MONTH),
+                                             bcd_to_bin(rtc_table[DS_ADDR_YEAR]));
 }
 
-// increment month
-void ds_month_incr() {
-    uint8_t month = ds_split2int(rtc_table[DS_ADDR_MONTH]&DS_MASK_MONTH);
-    if (month < 12)
-        month++;
-    else
-        month = 1;
-    ds_writebyte(DS_ADDR_MONTH, ds_int2bcd(month));
-	ds_set_day_of_week();
+// step a field up by one, wrapping around at the end of its range. only
+// rtc_table is changed; ds_commit() writes it to the DS1302.
+void ds_field_incr(uint8_t field) {
+    uint8_t addr, v, max;
+
+    if ((ds_field_flags[field] & DS_FF_12H) && H12_24)
+        field++;
+    addr = ds_field_addr[field];
+    v = rtc_table[addr] & ds_field_mask[field];
+    max = ds_field_flags[field] & DS_FF_MDAY ? ds_month_days() : ds_field_max[field];
+    if (v >= max && (ds_field_flags[field] & DS_FF_PM))
+        rtc_table[addr] ^= DS_MASK_PM;
+    v = bcd_incr(v, ds_field_min[field], max);
+    rtc_table[addr] = (rtc_table[addr] & ~ds_field_mask[field]) | v;
+    if (ds_field_flags[field] & DS_FF_DATE)
+        ds_date_fix();
+    ds_dirty |= 1 << addr;
 }
 
-// increment day
-void ds_day_incr() {
-    uint8_t day = ds_split2int(rtc_table[DS_ADDR_DAY]&DS_MASK_DAY);
-    if (day < 31)
-        day++;
-    else
-        day = 1;
-    ds_writebyte(DS_ADDR_DAY, ds_int2bcd(day));
-	ds_set_day_of_week();
-}
+// write the edited clock back. the clock kept running while it was set,
+// so the registers that were not edited are burst-read again first, and
+// only the edited ones are written, one single-byte write each. this is
+// not a burst write: a clock burst write has to cover all 8 registers,
+// the seconds too, and would restart the DS1302's count towards the next
+// second.
+void ds_commit() {
+    uint8_t now[8], mode, i;
+
+    if (!ds_dirty)
+        return;
+    mode = rtc_table[DS_ADDR_HOUR] & DS_MASK_AMPM_MODE;
+    ds_burst_read(DS_BURST_CLOCK, now, 8);
+    for (i = 0; i < 8; i++) {
+        if (!(ds_dirty & 1 << i))
+            rtc_table[i] = now[i];
+    }
 
-// increment year
-void ds_year_incr() {
-	uint8_t year = ds_split2int(rtc_table[DS_ADDR_YEAR]&DS_MASK_YEAR);
-	if (year < 99)
-		year++;
-	else
-		year = 0;
-	ds_writebyte(DS_ADDR_YEAR, ds_int2bcd(year));
-	ds_set_day_of_week();
+    // only the mode was toggled: convert the current hour to it
+    if (ds_dirty & DS_DIRTY_MODE) {
+        if ((rtc_table[DS_ADDR_HOUR] & DS_MASK_AMPM_MODE) != mode)
+            rtc_table[DS_ADDR_HOUR] = mode ? bcd_24to12(rtc_table[DS_ADDR_HOUR] & DS_MASK_HOUR24)
+                                           : bcd_12to24(rtc_table[DS_ADDR_HOUR]);
+        ds_dirty |= 1 << DS_ADDR_HOUR;
+    }
+
+    // an edited day can meet a month that has moved on meanwhile
+    if (ds_dirty & DS_DIRTY_DATE) {
+        ds_date_fix();
+        ds_dirty |= 1 << DS_ADDR_DAY | 1 << DS_ADDR_WEEKDAY;
+    }
+
+    ds_writebyte(DS_ADDR_WP, 0);
+    for (i = DS_ADDR_MINUTES; i <= DS_ADDR_YEAR; i++) {
+        if (ds_dirty & 1 << i)
+            ds_writebyte(i, rtc_table[i]);
+    }
+    ds_dirty = 0;
+    ds_sync();
 }
 
 /*
@@ -256,55 +502,9 @@ void ds_weekday_incr() {
 }
 */
 
-void ds_set_day_of_week() {
-
-	// Zeller's congruence
-	// https://en.wikipedia.org/wiki/Zeller%27s_congruence
-
-	uint8_t q = ds_split2int(rtc_table[DS_ADDR_DAY]&DS_MASK_DAY);
-	uint8_t m = ds_split2int(rtc_table[DS_ADDR_MONTH]&DS_MASK_MONTH);
-	uint8_t K = ds_split2int(rtc_table[DS_ADDR_YEAR]&DS_MASK_YEAR);
-	uint8_t J = 20;
-	uint8_t h;
-
-	// Jan & Feb need to be treated as months 13 and 14 of the previous year
-	if (m < 3) {
-		m += 12;
-		K--;
-	}
-
-	// the meat and potatoes
-	// https://stackoverflow.com/questions/15127615/determining-day-of-the-week-using-zellers-congruence
-	h = q + (13*(m+1))/5 + K + (K/4) + (J/4) + (5*J);
-	h %= 7;
-
-	// in Zeller's congruence Sunday = 0
-	// the DS1302 does use 0, so increment result by 1; thus Sunday = 1
-	h++;
-
-	ds_writebyte(DS_ADDR_WEEKDAY, h);
-}
-
 /*
 void ds_sec_zero() {
     rtc_table[DS_ADDR_SECONDS]=0;
     ds_writebyte(DS_ADDR_SECONDS,0);
 }
 */
-    
-uint8_t ds_split2int(uint8_t tens_ones) {
-    return (tens_ones>>4) * 10 + (tens_ones&0xF);
-}
-
-// return bcd byte from integer
-uint8_t ds_int2bcd(uint8_t integer) {
-    return integer / 10 << 4 | integer % 10;
-}
-
-uint8_t ds_int2bcd_tens(uint8_t integer) {
-    return integer / 10 % 10;
-}
-
-uint8_t ds_int2bcd_ones(uint8_t integer) {
-    return integer % 10;
-}
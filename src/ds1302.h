@@ -2,13 +2,33 @@
 // http://datasheets.maximintegrated.com/en/ds/DS1302.pdf
 //
 
-#include "stc15.h"
+#include "hal.h"
 #include <stdint.h>
 
 #define DS_CE    P0_0
 #define DS_IO    P0_1
 #define DS_SCLK  P3_2
 
+// with the 10k pull-ups removed (DS_PUSHPULL) DS_IO is a push-pull output,
+// so it has to be switched to an input while the DS1302 drives it. for a
+// read, ds_begin() does that before the falling SCLK edge that ends the
+// command, when the DS1302 starts driving.
+#ifdef DS_PUSHPULL
+#define ds_io_input()   { P0M0 &= ~0x02; P0M1 |= 0x02; }
+#define ds_io_output()  { P0M1 &= ~0x02; P0M0 |= 0x02; }
+#else
+#define ds_io_input()
+#define ds_io_output()
+#endif
+
+// on the stock board a low DS_IO latch sinks current through its 10k
+// pull-up (~.3mA), so it is set high again after each write
+#ifdef DS_PUSHPULL
+#define ds_io_release()
+#else
+#define ds_io_release()  DS_IO = 1
+#endif
+
 #define DS_CMD        1 << 7
 #define DS_CMD_READ   1
 #define DS_CMD_WRITE  0
@@ -27,6 +47,10 @@
 
 #define DS_BURST_MODE       31
 
+// burst transfer commands (read/write bit added by ds_burst_read/ds_burst_write)
+#define DS_BURST_CLOCK      (DS_CMD | DS_CMD_CLOCK | DS_BURST_MODE << 1)
+#define DS_BURST_RAM        (DS_CMD | DS_CMD_RAM | DS_BURST_MODE << 1)
+
 // DS_ADDR_SECONDS	c111_1111	0_0-5_9 c=clock_halt
 // DS_ADDR_MINUTES	x111_1111	0_0-5_9
 // DS_ADDR_HOUR		a0b1_1111	0_1-1_2/0_0-2_3 - a=12/not 24, b=not AM/PM if a=1 , else hour(0x20) 
@@ -59,61 +83,51 @@
 #define DS_MASK_YEAR_TENS     0b11110000
 #define DS_MASK_YEAR_UNITS    0b00001111
 
-/* 
-  NB: the rtc and config bits below were originally structs/unions, but for some reason 
-  the resulting code was bloated coming out of sdcc. This is attempt to recreate this
-  struct/union functionality directly, by explicit selection of bit/byte iram addressing
-  and using masks above. Because this current implementation is much more complex than
-  dealing with structs/unions, would like to someday return to simpler struct/union access
-  if code size allows (sdcc optimizations?).
-*/
-
-// 8051 zone from 0x20 and 0x2F in IRAM can be accessed as bit (between 0x00 and 0x7F)
-// 0x20, bit 0 is __bit __at (0x00), bit 7 is __bit __at (0x07) etc...
-
-uint8_t __at (0x24) rtc_table[8];
-
-// h12.tenhour in RTC is at address 0x26, bit 4 -> => 0x26-0x20 => 0x6*8+4 => 52 => 0x34
-__bit __at (0x34) H12_TH;
-// h12.pm in RTC is at address 0x26, bit 5 -> => 0x26-0x20 => 0x6*8+5 => 53 => 0x35
-__bit __at (0x35) H12_PM;
-// hour_12_24 in RTC is at address 0x26, bit 7 -> => 0x26-0x20 => 0x6*8+7 => 55 => 0x37
-__bit __at (0x37) H12_24;
-
-// config in DS1302 RAM
-
-uint8_t __at (0x2c) cfg_table[4];
-
-#define CFG_ALARM_HOURS_BYTE   0
-#define CFG_ALARM_MINUTES_BYTE 1
-#define CFG_TEMP_BYTE          2
-
-#define CFG_ALARM_HOURS_MASK   0b11111000
-#define CFG_ALARM_MINUTES_MASK 0b00111111
-#define CFG_TEMP_MASK          0b00000111
-
-// Offset 0 => alarm_hour (7..3) / chime_on (2) / alarm_on (1) / temp_C_F (0)
-// Offset 1 => (7) not used / (6) sw_mmdd / alarm_minute (5..0)
-// Offset 2 => chime_hour_start (7..3) / temp_offset (2..0), signed -4 / +3
-// Offset 3 => (7),(6)&(5) not used / chime_hour_stop (4..0)
-
-// temp_C_F in config is at address 0x2c, bit 0 => 0x2c-0x20 => 0xc*8+0 => 96 => 0x60
-__bit __at (0x60) CONF_C_F;
-__bit __at (0x61) CONF_ALARM_ON;
-__bit __at (0x62) CONF_CHIME_ON;
-__bit __at (0x6E) CONF_SW_MMDD;
+// rtc_table and cfg_table sit at fixed addresses in the bit addressable IRAM,
+// with __bit aliases for single bits (H12_24, CONF_ALARM_ON...) and BYTE/MASK/
+// SHIFT macros for the config fields (CFG_BRIGHT...). sdcc made bloated code
+// out of structs and unions for these. The layout, and the checks that
+// nothing overlaps, are generated from layout.txt (make layout).
+#include "layout.h"
 
 // DS1302 Functions
 
 void ds_ram_config_init();
 void ds_ram_config_write();
 
+// start a transfer: select the ds1302 and send the command byte; for a
+// read DS_IO is an input afterwards (see ds_io_input())
+void ds_begin(uint8_t cmd);
+
 // ds1302 single-byte read
 uint8_t ds_readbyte(uint8_t addr);
 
+// ds1302 burst transfers of len bytes from register/RAM byte 0 on.
+// cmd is DS_BURST_CLOCK or DS_BURST_RAM. a clock burst write has to cover all 8 clock registers.
+void ds_burst_read(uint8_t cmd, __data uint8_t *buf, uint8_t len);
+void ds_burst_write(uint8_t cmd, __data uint8_t *buf, uint8_t len);
+
 // ds1302 burst-read 8 bytes into struct
 void ds_readburst();
 
+// set by ds_readburst(); cleared by whoever consumes the new rtc_table contents
+extern __bit ds_updated;
+
+// cached clock
+//
+// rtc_table is only re-read from the DS1302 when it can have changed: ds_sync()
+// reads it right away (start-up, wake, after setting a value), ds_tick() is
+// called once per main loop tick and re-reads it when the seconds edge is due.
+// ds_phase counts loop ticks since the last seconds edge.
+#define DS_TICKS_PER_SECOND 10
+extern uint8_t ds_phase;
+
+// read the clock now and start looking for the next seconds edge
+void ds_sync();
+
+// advance the cached clock by one tick
+void ds_tick();
+
 // ds1302 single-byte write
 void ds_writebyte(uint8_t addr, uint8_t data);
 
@@ -126,36 +140,37 @@ void ds_halt();
 // reset date/time to 01/01 00:00
 void ds_reset_clock();
 
+// setting the clock
+//
+// edits only change rtc_table and mark their register in ds_dirty (bit
+// DS_ADDR_x), which also stops ds_tick() from re-reading the clock over
+// them. when the user is done, ds_commit() burst-reads the clock to pick up
+// the current values of the registers that were not edited, then writes
+// only the edited ones, one single-byte write each. the seconds are never
+// written, so setting the clock doesn't restart the current second.
+extern uint8_t ds_dirty;
+
+// fields for ds_field_incr(); DS_FIELD_HOUR follows the 12/24 hour mode
+#define DS_FIELD_HOUR       0
+#define DS_FIELD_MINUTES    2
+#define DS_FIELD_DAY        3
+#define DS_FIELD_MONTH      4
+#define DS_FIELD_YEAR       5
+#define DS_FIELD_NONE       0xFF
+
+// step a field up by one, wrapping around
+void ds_field_incr(uint8_t field);
+
 // toggle 12/24 hour mode
 void ds_hours_12_24_toggle();
-    
-// increment hours
-void ds_hours_incr();
 
-// increment minutes
-void ds_minutes_incr();
-
-// increment month
-void ds_month_incr();
-
-// increment day
-void ds_day_incr();
-
-void ds_year_incr();
+// write rtc_table back to the DS1302 if it has been edited
+void ds_commit();
 
 //void ds_weekday_incr();
 
-void ds_set_day_of_week();
+// clamp the day to the month and set the weekday, in rtc_table
+void ds_date_fix();
 
 //void ds_sec_zero();
     
-// split bcd to int
-uint8_t ds_split2int(uint8_t tens_ones);
-
-// return bcd byte from integer
-uint8_t ds_int2bcd(uint8_t integer);
-    
-// convert integer to bcd parts (high = tens, low = ones)
-uint8_t ds_int2bcd_tens(uint8_t integer);
-uint8_t ds_int2bcd_ones(uint8_t integer);
-    
@@ -0,0 +1,104 @@
+// Pads an __asm block with DS_NOPS nop instructions (0 to 31):
+//
+//     #define DS_NOPS DS_W_HIGH
+//     #include "ds1302_nops.h"
+//
+// See the bus timing notes in ds1302.c.
+
+#if DS_NOPS > 31
+#error "DS1302 bus delay too long for ds1302_nops.h"
+#endif
+#if DS_NOPS > 0
+			nop
+#endif
+#if DS_NOPS > 1
+			nop
+#endif
+#if DS_NOPS > 2
+			nop
+#endif
+#if DS_NOPS > 3
+			nop
+#endif
+#if DS_NOPS > 4
+			nop
+#endif
+#if DS_NOPS > 5
+			nop
+#endif
+#if DS_NOPS > 6
+			nop
+#endif
+#if DS_NOPS > 7
+			nop
+#endif
+#if DS_NOPS > 8
+			nop
+#endif
+#if DS_NOPS > 9
+			nop
+#endif
+#if DS_NOPS > 10
+			nop
+#endif
+#if DS_NOPS > 11
+			nop
+#endif
+#if DS_NOPS > 12
+			nop
+#endif
+#if DS_NOPS > 13
+			nop
+#endif
+#if DS_NOPS > 14
+			nop
+#endif
+#if DS_NOPS > 15
+			nop
+#endif
+#if DS_NOPS > 16
+			nop
+#endif
+#if DS_NOPS > 17
+			nop
+#endif
+#if DS_NOPS > 18
+			nop
+#endif
+#if DS_NOPS > 19
+			nop
+#endif
+#if DS_NOPS > 20
+			nop
+#endif
+#if DS_NOPS > 21
+			nop
+#endif
+#if DS_NOPS > 22
+			nop
+#endif
+#if DS_NOPS > 23
+			nop
+#endif
+#if DS_NOPS > 24
+			nop
+#endif
+#if DS_NOPS > 25
+			nop
+#endif
+#if DS_NOPS > 26
+			nop
+#endif
+#if DS_NOPS > 27
+			nop
+#endif
+#if DS_NOPS > 28
+			nop
+#endif
+#if DS_NOPS > 29
+			nop
+#endif
+#if DS_NOPS > 30
+			nop
+#endif
+#undef DS_NOPS
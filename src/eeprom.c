@@ -0,0 +1,213 @@
+// Constant tables in the data flash region, and IAP access to it
+//
+// Both tables are placed with __at past the end of program flash; see
+// eeprom.h for the layout. The generated string table is checked against
+// the first sector here, so an overlong strtab.txt fails the build.
+//
+
+#include "eeprom.h"
+
+#define STRTAB_DATA
+#include "strtab.h"
+
+#if EE_STRTAB + STRTAB_SIZE > EE_LOG
+#error "strtab.txt does not fit in the first data flash sector"
+#endif
+#if EE_LOG + EE_SECTOR_SIZE > EE_BASE + EE_SIZE
+#error "no data flash sector left for the usage log"
+#endif
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+
+// IAP_CMD
+#define IAP_READ     0x01
+#define IAP_PROGRAM  0x02
+#define IAP_ERASE    0x03
+
+// IAP_CONTR: enable, and the flash timing for the clock (WT2..0)
+#define IAP_EN       0x80
+#if SYSCLK <= 6000
+#define IAP_WAIT     0x04
+#elif SYSCLK <= 12000
+#define IAP_WAIT     0x03
+#elif SYSCLK <= 20000
+#define IAP_WAIT     0x02
+#else
+#define IAP_WAIT     0x01
+#endif
+
+// run one IAP command. the CPU stalls until it is done; afterwards the
+// IAP is disabled and pointed outside the data flash, so a stray trigger
+// cannot change it
+static uint8_t ee_iap(uint8_t cmd, uint16_t addr) {
+	IAP_CONTR = IAP_EN | IAP_WAIT;
+	IAP_CMD = cmd;
+	IAP_ADDRL = addr & 0xFF;
+	IAP_ADDRH = addr >> 8;
+#ifdef __SDCC
+	IAP_TRIG = 0x5A;
+	IAP_TRIG = 0xA5;
+	hal_nop();
+#else
+	board_iap();
+#endif
+	IAP_CONTR = 0;
+	IAP_CMD = 0;
+	IAP_TRIG = 0;
+	IAP_ADDRH = 0x80;
+	IAP_ADDRL = 0;
+	return IAP_DATA;
+}
+
+uint8_t ee_read(uint16_t addr) {
+	return ee_iap(IAP_READ, addr);
+}
+
+void ee_write(uint16_t addr, uint8_t v) {
+	IAP_DATA = v;
+	ee_iap(IAP_PROGRAM, addr);
+}
+
+void ee_erase(uint16_t addr) {
+	ee_iap(IAP_ERASE, addr);
+}
+
+__code const uint8_t __at (EE_LEDTABLE) ledtable[EE_LEDTABLE_SIZE] = {
+	// digit to led digit lookup table
+	// dp,g,f,e,d,c,b,a
+	// 0 = on, 1 = off
+	0b11000000, // 0
+	0b11111001, // 1
+	0b10100100, // 2
+	0b10110000, // 3
+	0b10011001, // 4
+	0b10010010, // 5
+	0b10000010, // 6
+	0b11111000, // 7
+	0b10000000, // 8
+	0b10011000, // 9
+	0b10001000, // A
+	0b10000011, // b
+	0b11000110, // C
+	0b10100001, // d
+	0b10000110, // E
+	0b10001110, // F
+	0b11111111, // 0x10 - ' '
+	0b10111111, // 0x11 - '-'
+	0b10001011, // 0x12 - 'h'
+	0b01111111, // 0x13 - '.'
+	0b10101111, // 0x14 - 'r'
+	0b10001001, // 0x15 - 'H'
+	0b10100011, // 0x16 - 'o'
+	0b10101011, // 0x17 - 'n'
+	0b11101010, // 0x18 - 'M'
+	0b10000111, // 0x19 - 't'
+	0b11100011, // 0x1A - 'u'
+	0b10010010, // 0x1B - 'S'
+	0b11010101, // 0x1C - 'W'
+	0b11000111, // 0x1D - 'L'
+	0b11111011, // 0x1E - 'i'
+	0b11011111, // 0x1F - '''
+
+	// 0x20 - 0x7F: ASCII, for the strings in strtab.txt.
+	// letters with no usable seven segment shape (K, M, V, W, X, ...)
+	// borrow the nearest one; upper and lower case may look the same.
+	0b11111111, // 0x20 - ' '
+	0b01111001, // 0x21 - '!'
+	0b11011101, // 0x22 - '"'
+	0b10000001, // 0x23 - '#'
+	0b10010010, // 0x24 - '$'
+	0b00101101, // 0x25 - '%'
+	0b10111001, // 0x26 - '&'
+	0b11011111, // 0x27 - '''
+	0b11000110, // 0x28 - '('
+	0b11110000, // 0x29 - ')'
+	0b10011100, // 0x2A - '*'
+	0b10001111, // 0x2B - '+'
+	0b01101111, // 0x2C - ','
+	0b10111111, // 0x2D - '-'
+	0b01111111, // 0x2E - '.'
+	0b10101101, // 0x2F - '/'
+	0b11000000, // 0x30 - '0'
+	0b11111001, // 0x31 - '1'
+	0b10100100, // 0x32 - '2'
+	0b10110000, // 0x33 - '3'
+	0b10011001, // 0x34 - '4'
+	0b10010010, // 0x35 - '5'
+	0b10000010, // 0x36 - '6'
+	0b11111000, // 0x37 - '7'
+	0b10000000, // 0x38 - '8'
+	0b10011000, // 0x39 - '9'
+	0b11110110, // 0x3A - ':'
+	0b11110010, // 0x3B - ';'
+	0b10011110, // 0x3C - '<'
+	0b10110111, // 0x3D - '='
+	0b10111100, // 0x3E - '>'
+	0b00101100, // 0x3F - '?'
+	0b10100000, // 0x40 - '@'
+	0b10001000, // 0x41 - 'A'
+	0b10000011, // 0x42 - 'B'
+	0b11000110, // 0x43 - 'C'
+	0b10100001, // 0x44 - 'D'
+	0b10000110, // 0x45 - 'E'
+	0b10001110, // 0x46 - 'F'
+	0b11000010, // 0x47 - 'G'
+	0b10001001, // 0x48 - 'H'
+	0b11111001, // 0x49 - 'I'
+	0b11100001, // 0x4A - 'J'
+	0b10001010, // 0x4B - 'K'
+	0b11000111, // 0x4C - 'L'
+	0b11101010, // 0x4D - 'M'
+	0b11001000, // 0x4E - 'N'
+	0b11000000, // 0x4F - 'O'
+	0b10001100, // 0x50 - 'P'
+	0b10010100, // 0x51 - 'Q'
+	0b10101111, // 0x52 - 'R'
+	0b10010010, // 0x53 - 'S'
+	0b10000111, // 0x54 - 'T'
+	0b11000001, // 0x55 - 'U'
+	0b11000001, // 0x56 - 'V'
+	0b11010101, // 0x57 - 'W'
+	0b10001001, // 0x58 - 'X'
+	0b10010001, // 0x59 - 'Y'
+	0b10100100, // 0x5A - 'Z'
+	0b11000110, // 0x5B - '['
+	0b10011011, // 0x5C - '\'
+	0b11110000, // 0x5D - ']'
+	0b11011100, // 0x5E - '^'
+	0b11110111, // 0x5F - '_'
+	0b11111101, // 0x60 - '`'
+	0b10100000, // 0x61 - 'a'
+	0b10000011, // 0x62 - 'b'
+	0b10100111, // 0x63 - 'c'
+	0b10100001, // 0x64 - 'd'
+	0b10000100, // 0x65 - 'e'
+	0b10001110, // 0x66 - 'f'
+	0b10010000, // 0x67 - 'g'
+	0b10001011, // 0x68 - 'h'
+	0b11111011, // 0x69 - 'i'
+	0b11110011, // 0x6A - 'j'
+	0b10001010, // 0x6B - 'k'
+	0b11111001, // 0x6C - 'l'
+	0b11101010, // 0x6D - 'm'
+	0b10101011, // 0x6E - 'n'
+	0b10100011, // 0x6F - 'o'
+	0b10001100, // 0x70 - 'p'
+	0b10011000, // 0x71 - 'q'
+	0b10101111, // 0x72 - 'r'
+	0b10010010, // 0x73 - 's'
+	0b10000111, // 0x74 - 't'
+	0b11100011, // 0x75 - 'u'
+	0b11100011, // 0x76 - 'v'
+	0b11010101, // 0x77 - 'w'
+	0b10001001, // 0x78 - 'x'
+	0b10010001, // 0x79 - 'y'
+	0b10100100, // 0x7A - 'z'
+	0b11000110, // 0x7B - '{'
+	0b11111001, // 0x7C - '|'
+	0b11110000, // 0x7D - '}'
+	0b11111110, // 0x7E - '~'
+	0b11111111  // 0x7F - DEL
+};
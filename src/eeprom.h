@@ -0,0 +1,51 @@
+// Constant data in the data flash (EEPROM) region
+//
+// On the 4K parts the 1K of data flash follows the program flash and reads
+// like code memory with MOVC, so lookup tables kept there cost no program
+// space. "make eeprom" splits these records out of main.hex for stc-isp.
+// It is erased and written in 512 byte sectors through the IAP registers;
+// the firmware only ever erases the second sector.
+//
+// 0x1000  ledtable[128]   segment patterns; 0x00-0x1F are the LED_ indices
+//                          of led.h, 0x20-0x7F the ASCII characters
+// 0x1080  strtab[]        display strings, generated from strtab.txt
+// 0x1200  (sector 1)      usage log, written at run time; see stats.h
+//
+
+#ifndef _EEPROM_H_
+#define _EEPROM_H_
+
+#include "hal.h"
+#include <stdint.h>
+
+#define EE_BASE           0x1000
+#ifndef EE_SIZE
+#define EE_SIZE           0x0400
+#endif
+
+#define EE_SECTOR_SIZE    0x0200
+
+#define EE_LEDTABLE       EE_BASE
+#define EE_LEDTABLE_SIZE  0x80
+#define EE_STRTAB         (EE_LEDTABLE + EE_LEDTABLE_SIZE)
+#define EE_LOG            (EE_BASE + EE_SECTOR_SIZE)
+
+// IAP addresses count from the start of the data flash
+#define EE_IAP(addr)      ((addr) - EE_BASE)
+
+extern __code const uint8_t ledtable[EE_LEDTABLE_SIZE];
+extern __code const uint8_t strtab[];
+
+// all reads go through these, so the tables could move behind IAP reads
+// (or into program flash on a bigger part) without touching the callers
+#define ee_glyph(c)       (ledtable[c])
+#define ee_str(i)         (strtab[i])
+
+// IAP access, by IAP address. a write can only clear bits; erase the
+// sector (any address in it) to set them again. run these at full clock
+// speed, as IAP_CONTR is set up for SYSCLK
+uint8_t ee_read(uint16_t addr);
+void ee_write(uint16_t addr, uint8_t v);
+void ee_erase(uint16_t addr);
+
+#endif
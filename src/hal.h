@@ -0,0 +1,50 @@
+// Hardware abstraction
+//
+// The firmware is built with sdcc for the STC15F204EA. The same sources also
+// build natively ("make host") against the board model in host/, which steps
+// a virtual clock instead of running on a CPU. Everything that differs
+// between the two builds is kept here: the SFRs, the sdcc keywords and the
+// CPU power modes. Inline assembly stays in the sources, next to a C
+// version for the host build.
+//
+
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <stdint.h>
+
+#ifdef __SDCC
+
+#include "stc15.h"
+
+#define hal_nop()         __asm nop __endasm
+#define hal_idle()        (PCON |= 0x01)
+#define hal_power_down()  (PCON |= 0x02)
+
+#else
+
+// host build: SFRs live in host/board.c
+#include "board.h"
+
+#define __bit             uint8_t
+#define __at(addr)
+#define __data
+#define __idata
+#define __code
+#define __interrupt(n)
+#define __using(n)
+#define __critical
+
+// bit n of a byte; stands in for the sdcc bit addressing of IRAM 0x20-0x2F
+#define HAL_BIT(byte, n)  (((byte) >> (n)) & 1)
+
+#define hal_nop()         board_cycles(1)
+#define hal_idle()        board_idle()
+#define hal_power_down()  board_power_down()
+
+// host/watch.c has the real main() and runs the firmware from it
+#define main              firmware_main
+
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+// generated by tools/mklayout.py from layout.txt; do not edit
+//
+// see tools/mklayout.py for the format
+
+// bytes 0x20-0x23 are left to sdcc for 32 __bit variables (16 in use)
+#define LAYOUT_END  0x30
+
+#if defined(DATA_LOC) && DATA_LOC < LAYOUT_END
+#error "the tables of layout.txt run past --data-loc"
+#endif
+
+uint8_t __at (0x24) rtc_table[8];
+uint8_t __at (0x2c) cfg_table[4];
+
+#ifdef __SDCC
+__bit __at (0x34) H12_TH;	// rtc_table[2].4
+__bit __at (0x35) H12_PM;	// rtc_table[2].5
+__bit __at (0x37) H12_24;	// rtc_table[2].7
+__bit __at (0x60) CONF_C_F;	// cfg_table[0].0
+__bit __at (0x61) CONF_ALARM_ON;	// cfg_table[0].1
+__bit __at (0x62) CONF_CHIME_ON;	// cfg_table[0].2
+__bit __at (0x6e) CONF_SW_MMDD;	// cfg_table[1].6
+#else
+// host build: read-only; change the tables with the masks instead
+#define H12_TH         HAL_BIT(rtc_table[2], 4)
+#define H12_PM         HAL_BIT(rtc_table[2], 5)
+#define H12_24         HAL_BIT(rtc_table[2], 7)
+#define CONF_C_F       HAL_BIT(cfg_table[0], 0)
+#define CONF_ALARM_ON  HAL_BIT(cfg_table[0], 1)
+#define CONF_CHIME_ON  HAL_BIT(cfg_table[0], 2)
+#define CONF_SW_MMDD   HAL_BIT(cfg_table[1], 6)
+#endif
+
+#define H12_TH_BYTE              2	// rtc_table[2]
+#define H12_TH_MASK              0b00010000
+#define H12_PM_BYTE              2	// rtc_table[2]
+#define H12_PM_MASK              0b00100000
+#define H12_24_BYTE              2	// rtc_table[2]
+#define H12_24_MASK              0b10000000
+#define CONF_C_F_BYTE            0	// cfg_table[0]
+#define CONF_C_F_MASK            0b00000001
+#define CONF_ALARM_ON_BYTE       0	// cfg_table[0]
+#define CONF_ALARM_ON_MASK       0b00000010
+#define CONF_CHIME_ON_BYTE       0	// cfg_table[0]
+#define CONF_CHIME_ON_MASK       0b00000100
+#define CONF_SW_MMDD_BYTE        1	// cfg_table[1]
+#define CONF_SW_MMDD_MASK        0b01000000
+
+#define CFG_ALARM_HOURS_BYTE     0	// cfg_table[0]
+#define CFG_ALARM_HOURS_MASK     0b11111000
+#define CFG_ALARM_HOURS_SHIFT    3
+#define CFG_ALARM_MINUTES_BYTE   1	// cfg_table[1]
+#define CFG_ALARM_MINUTES_MASK   0b00111111
+#define CFG_ALARM_MINUTES_SHIFT  0
+#define CFG_TEMP_BYTE            2	// cfg_table[2]
+#define CFG_TEMP_MASK            0b00000111
+#define CFG_TEMP_SHIFT           0
+#define CFG_CHIME_START_BYTE     2	// cfg_table[2]
+#define CFG_CHIME_START_MASK     0b11111000
+#define CFG_CHIME_START_SHIFT    3
+#define CFG_CHIME_STOP_BYTE      3	// cfg_table[3]
+#define CFG_CHIME_STOP_MASK      0b00011111
+#define CFG_CHIME_STOP_SHIFT     0
+#define CFG_BRIGHT_BYTE          3	// cfg_table[3]
+#define CFG_BRIGHT_MASK          0b11100000
+#define CFG_BRIGHT_SHIFT         5
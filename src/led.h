@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include "eeprom.h"
 
 // index into ledtable[]
 #define LED_A		0x0A
@@ -25,45 +26,6 @@
 #define LED_i		0x1E
 #define LED_AP		0x1F
 
-const uint8_t __at (0x1000) ledtable[] 
-= {
-	// digit to led digit lookup table
-	// dp,g,f,e,d,c,b,a
-	// 0 = on, 1 = off
-	0b11000000, // 0
-	0b11111001, // 1
-	0b10100100, // 2
-	0b10110000, // 3
-	0b10011001, // 4
-	0b10010010, // 5
-	0b10000010, // 6
-	0b11111000, // 7
-	0b10000000, // 8
-	0b10011000, // 9
-	0b10001000, // A
-	0b10000011, // b
-	0b11000110, // C
-	0b10100001, // d
-	0b10000110, // E
-	0b10001110, // F
-	0b11111111, // 0x10 - ' '
-	0b10111111, // 0x11 - '-'
-	0b10001011, // 0x12 - 'h'
-	0b01111111, // 0x13 - '.'
-	0b10101111, // 0x14 - 'r'
-	0b10001001, // 0x15 - 'H'
-	0b10100011, // 0x16 - 'o'
-	0b10101011, // 0x17 - 'n'
-	0b11101010, // 0x18 - 'M'
-	0b10000111, // 0x19 - 't'
-	0b11100011, // 0x1A - 'u'
-	0b10010010, // 0x1B - 'S'
-	0b11010101, // 0x1C - 'W'
-	0b11000111, // 0x1D - 'L'
-	0b11111011, // 0x1E - 'i'
-	0b11011111  // 0x1f - '''
-};
-
 uint8_t	dbuf[4];
 uint8_t	tmpbuf[4];
 __bit	dot0;
@@ -75,8 +37,8 @@ __bit	dot3;
 #define filldisplay(pos,val,dp) { tmpbuf[pos]=(uint8_t)(val); if (dp) dot##pos=1;}
 #define dotdisplay(pos,dp) { if (dp) dot##pos=1;}
 #define updateTmpDisplay() { uint8_t tmp; \
-	tmp=ledtable[tmpbuf[0]]; if (dot0) tmp&=0x7F; dbuf[0]=tmp; \
-	tmp=ledtable[tmpbuf[1]]; if (dot1) tmp&=0x7F; dbuf[1]=tmp; \
-	tmp=ledtable[tmpbuf[3]]; if (dot3) tmp&=0x7F; dbuf[3]=tmp; \
-	tmp=ledtable[tmpbuf[2]]; if (dot2) tmp&=0x7F; dbuf[2]=tmp; \
+	tmp=ee_glyph(tmpbuf[0]); if (dot0) tmp&=0x7F; dbuf[0]=tmp; \
+	tmp=ee_glyph(tmpbuf[1]); if (dot1) tmp&=0x7F; dbuf[1]=tmp; \
+	tmp=ee_glyph(tmpbuf[3]); if (dot3) tmp&=0x7F; dbuf[3]=tmp; \
+	tmp=ee_glyph(tmpbuf[2]); if (dot2) tmp&=0x7F; dbuf[2]=tmp; \
 }
@@ -1,8 +1,14 @@
 #include <stdint.h>
 #include <stdio.h>
-#include "stc15.h"
+#include "hal.h"
 #include "led.h"
 #include "ds1302.h"
+#include "pins.h"
+#include "alarm.h"
+#include "battery.h"
+#include "stats.h"
+#include "bcd.h"
+#include "strtab.h"
 
 // so said EVELYN the modified DOG
 #pragma less_pedantic
@@ -11,28 +17,86 @@
 #define FOSC    11059200
 
 // create a nop 'function' consistent with STC15F204EA datasheet examples.
-#define _nop_(); 		__asm nop __endasm
+#define _nop_(); 		hal_nop()
 
 // create a 'function' to clear the watchdog timer
 #define WDT_CLEAR();	(WDT_CONTR |= 1 << 4)
 
+// clock divider (CLK_DIV, SYSCLK / 2^n) used while the CPU has nothing to do but
+// multiplex the display. main() runs at full speed; see clk_fast() and clk_slow().
+// timer0_isr must finish within one 100uS period at this speed:
+// (SYSCLK >> CLK_SLOW_DIV) / 10000 = 553 clocks at 11.0592MHz, 276 at a
+// divider of 2. the 276 cycle timer0_isr budget in tools/bench_baseline.json
+// is half of 553, a limit rather than a measurement. make bench times every call,
+// including the longest path (a digit switch and both buttons posting an event
+// in one pass, scenario isr_worst), and make bench-baseline records the worst
+// case as "worst" in the same file.
+// measured worst case: none yet; no s51 run has been recorded. CLK_SLOW_DIV
+// stays at 1 (SYSCLK / 2) until that number is far enough below 276 for 2.
+#define CLK_SLOW_DIV 1
+
+#ifndef SYSCLK
+#define SYSCLK 11059
+#endif
+
+// timer0 counts SYSCLK/12 after the clock divider; SYSCLK (kHz) / 120 counts =
+// 100uS, rounded: 92 at 11.0592MHz. the count must stay a whole number at
+// CLK_SLOW_DIV.
+#define T0_COUNTS ((SYSCLK + 60) / 120)
+#if (T0_COUNTS >> CLK_SLOW_DIV) << CLK_SLOW_DIV != T0_COUNTS
+#error "T0_COUNTS must be a multiple of 2^CLK_SLOW_DIV"
+#endif
+
+#ifndef SIM51
+#define T0_RELOAD(div) (0x10000 - (T0_COUNTS >> (div)))
+#define T0_MODE 0x00	// mode 0: 16 bit auto-reload on the STC15
+#else
+// build for the ucsim benchmarks (make bench). ucsim's 8051 has neither the
+// STC15 auto-reload timer (its mode 0 is the 13 bit timer) nor CLK_DIV.
+// bench.py runs it at 12 * SYSCLK, so one machine cycle takes one STC15
+// clock and timer0 counts SYSCLK: mode 1, reloaded by timer0_isr.
+#define T0_RELOAD(div) (0x10000 - T0_COUNTS * 12)
+#define T0_MODE 0x01
+#endif
+
 // control how often the display is updated
 // the higher the number, the less frequenly it's updated creating a dimmer display.
-#define display_refresh_rate 10
+// set from brightness_table by the brightness level stored in the DS1302 config.
+uint8_t display_refresh_rate = 10;
+
+// display_refresh_rate for each brightness level; level 0 is the brightest.
+// each digit is lit for 1 in display_refresh_rate timer0 interrupts.
+#define BRIGHT_LEVELS 8
+const uint8_t brightness_table[BRIGHT_LEVELS] = { 10, 13, 16, 20, 25, 32, 40, 50 };
 
-// counter used to maintain which LED to update
-volatile uint8_t display_refresh_counter = 0;
+// counts down the timer0 interrupts of one display refresh period;
+// digits 3..0 are lit on the last 4 of them, the display is dark for the rest
+volatile uint8_t display_refresh_counter = 1;
+
+// anode (P3) bit of each digit
+const uint8_t digit_enable[4] = { 0x10, 0x20, 0x40, 0x80 };
 
 // count main program loops; used to time how long display is on before powering off
 uint16_t display_show_counter = 0;
 
 // how many seconds to the display before the MCU goes into power down mode
-// original firmware had it around 3 seconds
-#define display_show_seconds 5
+// original firmware had it around 3 seconds; shortened on a low battery
+uint8_t display_show_seconds = 5;
+
+// how long the display flashes for the alarm, and shows the time for the chime
+#define ALARM_SECONDS 30
+#define CHIME_SECONDS 1
 
 // flag to determine when to display the colon
 volatile __bit  display_colon = 0;
 
+// set when something shown on the display may have changed; the display
+// buffers are only rebuilt when it is set
+__bit  display_dirty = 1;
+
+// mode, flashing digits and colon last shown; see main()
+uint8_t display_state = 0;
+
 // flags to control flashing pairs of digits
 __bit  flash_01 = 0;
 __bit  flash_23 = 0;
@@ -43,6 +107,7 @@ typedef enum {
 	K_SET_HOUR,
 	K_SET_MINUTE,
 	K_SET_HOUR_12_24,
+	K_SET_BRIGHT,
 	K_DATE_DISP,
 	K_SET_MONTH,
 	K_SET_DAY,
@@ -50,17 +115,27 @@ typedef enum {
 	K_SET_YEAR,
 	K_WEEKDAY_DISP,
 	K_MESSAGE_DISP,
-	K_DEBUG
+	K_SECONDS_DISP,
+	K_ALARM,
+	K_STATS,
+	K_SET_ALARM_HOUR,
+	K_SET_ALARM_MINUTE,
+	K_SET_ALARM_ON
 } keyboard_mode_t;
 
 // display mode states
 typedef enum {
 	M_NORMAL,
 	M_SET_HOUR_12_24,
+	M_SET_BRIGHT,
 	M_DATE_DISP,
 	M_YEAR_DISP,
 	M_WEEKDAY_DISP,
 	M_MESSAGE_DISP,
+	M_SECONDS_DISP,
+	M_STATS,
+	M_SET_ALARM,
+	M_SET_ALARM_ON,
 	M_DEBUG
 } display_mode_t;
 
@@ -76,71 +151,165 @@ display_mode_t dmode = M_NORMAL;
 volatile uint8_t debounce[2] = {0, 0};
 #define SW_CHECK 10 // * 100uS = how often button state is tested
 
+// counts down the timer0 interrupts to the next button check
+uint8_t sw_check_counter = SW_CHECK;
+
 // long button press detection
 volatile uint16_t switchcount[2] = {0, 0};
 #define SW_CNTMAX 1500	// * SW_CHECK * 100uS = time before long button press is registered
+#define SW_REPEAT 200	// * SW_CHECK * 100uS = time between repeats while a button is held after that
 
-// button states/flags
+// main loop pacing; timer0_isr sets loop_tick once every LOOP_TICKS button checks
+volatile uint8_t loop_tick_counter = 0;
+volatile __bit loop_tick = 0;
+#define LOOP_TICKS 100	// * SW_CHECK * 100uS = time between main loop iterations (100ms)
+
+// debounced button states; only written by timer0_isr
 volatile __bit  S1_PRESSED = 0;
-volatile __bit  S1_LONG = 0;
-volatile __bit	S1_READY = 0;
-volatile __bit	S1_READY_PRESSED = 0;
 volatile __bit  S2_PRESSED = 0;
-volatile __bit  S2_LONG = 0;
-volatile __bit	S2_READY = 0;
-volatile __bit	S2_READY_PRESSED = 0;
-
-// secret message displayed when both buttons are pressed
-uint8_t secret_msg[] = { 
-	LED_r,
-	LED_u,
-	LED_t,
-	LED_h,
-	LED_S,
-	LED_A,
-	LED_r,
-	LED_i,
-	LED_A,
-	LED_n,
-	LED_BLANK,
-	LED_W,
-	LED_A,
-	LED_S,
-	LED_BLANK,
-	LED_H,
-	LED_E,
-	LED_r,
-	LED_E
-};
+
+// set while both buttons are down; single button events are held back
+// until both have been released again
+__bit  sw_chord = 0;
+
+// button events, posted by timer0_isr into ev_queue.
+// the low nibble is the event, the high nibble the button.
+#define EV_NONE    0x00
+#define EV_PRESS   0x01	// button went down
+#define EV_SHORT   0x02	// button released before SW_CNTMAX
+#define EV_LONG    0x03	// button held down for SW_CNTMAX
+#define EV_REPEAT  0x04	// button still held, every SW_REPEAT after EV_LONG
+#define EV_S1      0x10
+#define EV_S2      0x20
+#define EV_CHORD   0x30	// both buttons held down for SW_CNTMAX
+
+// single producer (timer0_isr), single consumer (ev_get) ring buffer.
+// each side only writes its own index, and a byte write is atomic, so
+// neither side has to disable interrupts. events are dropped when it is full.
+#define EV_QUEUE_SIZE 8	// power of 2
+#define EV_QUEUE_MASK (EV_QUEUE_SIZE - 1)
+volatile uint8_t ev_queue[EV_QUEUE_SIZE];
+volatile uint8_t ev_head = 0;	// next slot written by timer0_isr
+volatile uint8_t ev_tail = 0;	// next slot read by ev_get()
 
 // higher value = slower scroll
 #define MSG_SCROLL_SPEED 4
 
-// delay by milliseconds
-void _delay_ms(uint8_t ms)
+// run the CPU at full speed; used for DS1302 transfers and button handling.
+// timer0 is stopped while its reload value changes, so it can't reload from
+// a half written TL0/TH0 pair; the next period then starts from the new value.
+void clk_fast(void)
+{
+	TR0 = 0;
+	CLK_DIV = 0;
+	TL0 = T0_RELOAD(0) & 0xFF;	// keep the timer0 interrupt at 100uS
+	TH0 = T0_RELOAD(0) >> 8;
+	TR0 = 1;
+}
+
+// slow the CPU down while it only multiplexes the display
+void clk_slow(void)
+{
+	TR0 = 0;
+	CLK_DIV = CLK_SLOW_DIV;
+	TL0 = T0_RELOAD(CLK_SLOW_DIV) & 0xFF;
+	TH0 = T0_RELOAD(CLK_SLOW_DIV) >> 8;
+	TR0 = 1;
+}
+
+// apply the brightness level stored in the config, dimmed further if the
+// battery is low
+void brightness_set(void)
+{
+	uint8_t level = cfg_table[CFG_BRIGHT_BYTE] >> CFG_BRIGHT_SHIFT;
+
+	if (level < battery_dim[battery_level]) {
+		level = battery_dim[battery_level];
+	}
+	display_refresh_rate = brightness_table[level];
+}
+
+// measure the battery and apply its power policy; call with the display
+// dark, as the LEDs pull the battery voltage down. takes about 1ms
+void battery_update(void)
+{
+	battery_check();
+	display_show_seconds = battery_show_seconds[battery_level];
+	brightness_set();
+}
+
+// step to the next dimmer brightness level (wrapping back to the brightest) and save it
+void brightness_incr(void)
+{
+	// the carry out of the top 3 bits is lost, wrapping level 7 back to 0
+	cfg_table[CFG_BRIGHT_BYTE] += 1 << CFG_BRIGHT_SHIFT;
+	ds_ram_config_write();
+	brightness_set();
+}
+
+// draw a string from strtab.h (its STR_ offset) into tmpbuf, the first
+// character at display position pos. characters that fall outside the 4
+// digits are skipped, so stepping pos down scrolls the string across.
+void text_draw(uint8_t str, int8_t pos)
 {
-	// delay function, tuned for 11.092 MHz clock
-	// optimized to assembler
-	ms; // keep compiler from complaining?
-	__asm;
-		; dpl contains ms param value
-		delay$:
-			mov	b, #8	; i
-		outer$:
-			mov	a, #243	; j
-		inner$:
-			djnz acc, inner$
-			djnz b, outer$
-			djnz dpl, delay$
-	__endasm;
+	uint8_t c;
+
+	do {
+		c = ee_str(str++);
+		if ((uint8_t)pos < 4) {
+			tmpbuf[pos] = c & 0x7F;
+		}
+		pos++;
+	} while (!(c & 0x80));
+}
+
+// usage counter shown in K_STATS; see stats.h
+uint8_t stats_item = 0;
+
+// step to the next usage counter
+void stats_next(void)
+{
+	stats_item = stats_item + 1 < STATS_ITEMS ? stats_item + 1 : 0;
+}
+
+// draw a counter in decimal, from 10000 on in thousands (e.g. 12.3k).
+// powers of 10 are subtracted, as there is no divide instruction to spare
+const uint16_t number_pow10[] = { 10000, 1000, 100, 10, 1 };
+
+void number_draw(uint16_t v)
+{
+	uint8_t d[5], i;
+
+	for (i = 0; i < 5; i++) {
+		d[i] = 0;
+		while (v >= number_pow10[i]) {
+			v -= number_pow10[i];
+			d[i]++;
+		}
+	}
+	if (d[0]) {
+		filldisplay(0, d[0], 0);
+		filldisplay(1, d[1], 1);
+		filldisplay(2, d[2], 0);
+		filldisplay(3, 'k', 0);
+	} else {
+		// no leading zeros
+		for (i = 1; i < 4 && !d[i]; i++) {
+			d[i] = LED_BLANK;
+		}
+		filldisplay(0, d[1], 0);
+		filldisplay(1, d[2], 0);
+		filldisplay(2, d[3], 0);
+		filldisplay(3, d[4], 0);
+	}
 }
 
 void sys_init(void)
 {
 	// setup LED display 
 	// Set IO pins for LED common anodes to push-pull output to provide more current
-	P3M0 |= 0xF0;
-	// P3M1 &= 0x0F;	// default value after power-on or reset
+	// (along with the DS1302 pins; see pins.c)
+	pins_set(PINS_DISPLAY_ON);
 
 	// LED segments should be set to quasi-bidirectional to sink the current
 	// P1M0 = 0x00;		// default value after power-on or reset
@@ -149,9 +318,11 @@ void sys_init(void)
 	// clock initialization
 	ds_init();
 	ds_ram_config_init();
+	battery_update();
+	stats_init();
 
 	// reset the clock if it has an invalid (00) month value
-	ds_readburst();
+	ds_sync();
 	if (rtc_table[DS_ADDR_MONTH] == 0x00) {
 		ds_reset_clock();
 	}
@@ -161,8 +332,9 @@ void sys_init(void)
 	EX1 = 0;	// begin with external interrupt disabled; it will be enabled as MCU goes to sleep
 
 	// setup display refresh timer
-	TL0 = 0xA4;		// Initial timer value
-	TH0 = 0xFF;		// Initial timer value
+	TMOD = T0_MODE;
+	TL0 = T0_RELOAD(0) & 0xFF;	// Initial timer value
+	TH0 = T0_RELOAD(0) >> 8;	// Initial timer value
 	TF0 = 0;		// Clear TF0 flag
 	TR0 = 1;		// Timer0 start run
 	ET0 = 1;		// enable timer0 interrupt
@@ -171,16 +343,33 @@ void sys_init(void)
 	EA  = 1;
 }
 
+// post a button event; see ev_queue
+#define EV_POST(e) { \
+	if (((ev_head + 1) & EV_QUEUE_MASK) != ev_tail) { \
+		ev_queue[ev_head] = (e); \
+		ev_head = (ev_head + 1) & EV_QUEUE_MASK; \
+	} \
+}
+
 // timer to manage display refresh and button press detection
+//
+// this runs every 100uS, so it's kept free of divisions and other calls into
+// the sdcc library; those would also force a full register save on entry.
+// the longest path is the button check pass. make bench reports its clock count
+// and checks it against the timer0_isr budget in tools/bench_baseline.json.
 void timer0_isr() __interrupt (1) __using (1)
 {
+	uint8_t ev;
+
+#ifdef SIM51
+	TL0 = T0_RELOAD(0) & 0xFF;
+	TH0 = T0_RELOAD(0) >> 8;
+#endif
+
 	//
 	// DISPLAY REFRESH
 	//
 
-	// which digit to update
-	uint8_t digit = display_refresh_counter % 4;
-
 	// 4 digit 7 segment LED display is common anode
 	// current into common anode of the digit (source current), out through the segment pins (sink current)
 
@@ -188,135 +377,355 @@ void timer0_isr() __interrupt (1) __using (1)
 	P3 &= 0x0F;
 
 	// test whether or not it's time to update the display
-	if (display_refresh_counter % display_refresh_rate < 4 ) {
-
-		// reset segments to all off
-		//P1 = 0xFF;
+	if (--display_refresh_counter < 4) {
 
 		// enable appropriate segment PINs (logic low)
-		P1 = dbuf[digit];
+		P1 = dbuf[display_refresh_counter];
 
 		// enable the digit (logic high)
-		P3 |= (0x10 << digit);
-	}
+		P3 |= digit_enable[display_refresh_counter];
 
-	display_refresh_counter++;
+		// digit 0 was the last one; start a new refresh period
+		if (display_refresh_counter == 0) {
+			display_refresh_counter = display_refresh_rate;
+		}
+	}
 
 	//
 	// BUTTON PRESS DETECTION
 	//
 
 	// slow down how often the button states are checked
-	if (display_refresh_counter % SW_CHECK == 0) {
-
-		// is the button down?
-		S1_PRESSED = debounce[0] == 0x00 ? 1 : 0;
-		S2_PRESSED = debounce[1] == 0x00 ? 1 : 0;
-
-		// set Sx_LONG flag if button was held down for a long time. 
-		// this flag must be cleared by the main loop.
-		if (S1_PRESSED && switchcount[0]++ == SW_CNTMAX) {
-			S1_LONG = 1;
-		} else if (!S1_PRESSED) {
-			switchcount[0] = 0;
-		}
-		if (S2_PRESSED && switchcount[1]++ == SW_CNTMAX) {
-			S2_LONG = 1;
-		} else if (!S2_PRESSED) {
-			switchcount[1] = 0;
-		}
+	if (--sw_check_counter == 0) {
+		sw_check_counter = SW_CHECK;
 
 		// read button states into sliding 8-bit window
 		// buttons are active low
 		debounce[0] = (debounce[0] << 1) | SW1;
 		debounce[1] = (debounce[1] << 1) | SW2;
+
+		// button 1
+		ev = EV_NONE;
+		if (debounce[0] == 0x00) {
+			if (!S1_PRESSED) {
+				S1_PRESSED = 1;
+				switchcount[0] = 0;
+				if (S2_PRESSED) {
+					sw_chord = 1;
+				} else {
+					ev = EV_S1 | EV_PRESS;
+				}
+			} else if (++switchcount[0] == SW_CNTMAX) {
+				if (!sw_chord) {
+					ev = EV_S1 | EV_LONG;
+				} else if (switchcount[1] >= SW_CNTMAX) {
+					ev = EV_CHORD;
+				}
+			} else if (switchcount[0] == SW_CNTMAX + SW_REPEAT) {
+				switchcount[0] = SW_CNTMAX;
+				ev = EV_S1 | EV_REPEAT;
+			}
+		} else if (S1_PRESSED) {
+			S1_PRESSED = 0;
+			if (switchcount[0] < SW_CNTMAX) {
+				ev = EV_S1 | EV_SHORT;
+			}
+		}
+		if (ev != EV_NONE && (!sw_chord || ev == EV_CHORD)) {
+			EV_POST(ev);
+		}
+
+		// button 2
+		ev = EV_NONE;
+		if (debounce[1] == 0x00) {
+			if (!S2_PRESSED) {
+				S2_PRESSED = 1;
+				switchcount[1] = 0;
+				if (S1_PRESSED) {
+					sw_chord = 1;
+				} else {
+					ev = EV_S2 | EV_PRESS;
+				}
+			} else if (++switchcount[1] == SW_CNTMAX) {
+				if (!sw_chord) {
+					ev = EV_S2 | EV_LONG;
+				} else if (switchcount[0] >= SW_CNTMAX) {
+					ev = EV_CHORD;
+				}
+			} else if (switchcount[1] == SW_CNTMAX + SW_REPEAT) {
+				switchcount[1] = SW_CNTMAX;
+				ev = EV_S2 | EV_REPEAT;
+			}
+		} else if (S2_PRESSED) {
+			S2_PRESSED = 0;
+			if (switchcount[1] < SW_CNTMAX) {
+				ev = EV_S2 | EV_SHORT;
+			}
+		}
+		if (ev != EV_NONE && (!sw_chord || ev == EV_CHORD)) {
+			EV_POST(ev);
+		}
+
+		// the chord is over once both buttons are up
+		if (!S1_PRESSED && !S2_PRESSED) {
+			sw_chord = 0;
+		}
+
+		// let the main loop run another iteration
+		if (++loop_tick_counter == LOOP_TICKS) {
+			loop_tick_counter = 0;
+			loop_tick = 1;
+		}
 	}
 }
 
+// set by INT1_routine; tells a SW1 wake from a wake-up timer wake
+volatile __bit wake_sw1 = 0;
+
 // INT0 = interrupt 0; Timer0 = interrupt 1; INT1 = interrupt 2;
+//
+// SW1 wakes the MCU up from power down. the press that did it is marked as
+// already handled, so it is not passed on as a button event (its release
+// would otherwise leave time mode for date mode right after waking up).
 void INT1_routine(void) __interrupt (2) 
 {
-	while (!SW1);
+	wake_sw1 = 1;
+
+	// held down past SW_CNTMAX: neither EV_LONG nor EV_SHORT follow
+	debounce[0] = 0x00;
+	S1_PRESSED = 1;
+	switchcount[0] = SW_CNTMAX;
 }
 
-// when entering new mode need to wait for previous button press to be released. 
-// at that point the button is READY to be used by the new button state
-//
-// Sx_READY indicates that the button state is relative to the current mode.
-//          it protects against a button held down through transition of modes
-//          so the new mode does not trigger off the old mode's button press.
-//
-// Sx_READY_PRESSED indicates the button has been pressed since entering the current mode.
-//                  this, combined with !Sx_PRESSED, will indicate a button press and release.
-//
-// Scenario: a button is pressed and held down. trigger ONCE off the button press then when
-//           Sx_LONG triggers, repeat the action.
-//
-// Solution: create a variable to note that the button has been triggered on so we don't do it again
-//           that's probably the correct way to do this.
-//
-//           however, we can abuse the Sx_READY flag instead because of how it's set. if it's unset
-//           after the short trigger, we can test Sx_READY as it will be reset to 1 after a button
-//           release. changes in how Sx_READY is set (handled in the function below) may affect
-//           this hack, so be aware.
-//			
-//           NOTE: if button_ready_check() were to reset Sx_READY_PRESSED when Sx_READY is unset,
-//                 then we'd also reset Sx_LONG and modes won't register LONG button presses.
-//
-//                 i think the correct, true to variable name, function would be to reset Sx_READY_PRESSED
-//                 when Sx_READY is reset. however this would break the above hack/solution.
-void button_ready_check(void) {
-
-	if (!S1_READY && !S1_PRESSED) {
-		S1_READY = 1;
-		S1_LONG = 0;
-	} else if (S1_READY && S1_PRESSED) {
-		S1_READY_PRESSED = 1;
+// take the next button event off ev_queue; EV_NONE if there is none
+uint8_t ev_get(void) {
+	uint8_t ev = EV_NONE;
+
+	if (ev_tail != ev_head) {
+		ev = ev_queue[ev_tail];
+		ev_tail = (ev_tail + 1) & EV_QUEUE_MASK;
 	}
+	return ev;
+}
 
-	if (!S2_READY && !S2_PRESSED) {
-		S2_READY = 1;
-		S2_LONG = 0;
-	} else if (S2_READY && S2_PRESSED) {
-		S2_READY_PRESSED = 1;
+// wait for the next main loop tick or button event; loop_tick tells which.
+// the CPU is put into IDLE mode between interrupts; timer0 keeps running and
+// its interrupt wakes the CPU up again, so the display is still refreshed.
+// while waiting the clock is divided down, so timer0_isr runs slower too.
+void loop_wait(void) {
+	clk_slow();
+	while (!loop_tick && ev_tail == ev_head) {
+		hal_idle();
 	}
+	clk_fast();
 }
 
 // call this function to change the keyboard mode.
 // this function will reset all appropriate variables before entering the new mode
 void change_kmode(keyboard_mode_t new_kmode) {
 
+	// leaving a set mode; write what was set to the DS1302
+	ds_commit();
+
 	// reset display power off counter
 	display_show_counter = 0;
 
-	// reset button 1 flags
-	S1_READY = 0;
-	S1_LONG = 0;
-	S1_READY_PRESSED = 0;
-
-	// reset button 2 flags
-	S2_READY = 0;
-	S2_LONG = 0;
-	S2_READY_PRESSED = 0;
-
 	// reset flashing digit flags
 	flash_01 = 0;
 	flash_23 = 0;
 
+	// redraw the display for the new mode
+	display_dirty = 1;
+
 	// switch to new keyboard mode
 	kmode = new_kmode;
 }
 
+// keyboard mode table
+//
+// every keyboard mode is one row of the tables below (indexed by kmode), run
+// by the interpreter in main():
+//
+//  - a button 1 press and release (EV_SHORT) changes to kmode_s1_short,
+//    holding it down (EV_LONG) changes to kmode_s1_long right away
+//  - button 2 either steps the clock field kmode_s2_field or runs
+//    kmode_s2_action (on EV_PRESS, and on EV_REPEAT with KF_REPEAT) or,
+//    with KF_S2_MODE, changes to kmode_s2_next on EV_SHORT (back to
+//    K_NORMAL on EV_LONG)
+//  - clock fields are edited in rtc_table only; change_kmode() writes
+//    them to the DS1302 when the mode is left
+//  - with KF_CHORD, holding both buttons (EV_CHORD) shows the secret message
+//  - K_STATS, the usage counters, is only reached by holding button 1 on
+//    the weekday
+//  - the alarm is set after the brightness; its time is kept in cfg_table
+//    and saved on each step, like the brightness
+//  - kmode_dmode is the display mode to show
+//
+// the tables are const, so sdcc keeps them in code memory.
+
+// row flags
+#define KF_FLASH_01	0x01	// flash digits 0 and 1 (hours, month)
+#define KF_FLASH_23	0x02	// flash digits 2 and 3 (minutes, day, year)
+#define KF_REPEAT	0x04	// holding button 2 repeats its action
+#define KF_S2_MODE	0x08	// button 2 changes mode instead of running an action
+#define KF_CHORD	0x10	// both buttons held shows the secret message
+
+const uint8_t kmode_flags[] = {
+	KF_S2_MODE | KF_CHORD,		// K_NORMAL
+	KF_FLASH_01 | KF_REPEAT,	// K_SET_HOUR
+	KF_FLASH_23 | KF_REPEAT,	// K_SET_MINUTE
+	0,				// K_SET_HOUR_12_24
+	0,				// K_SET_BRIGHT
+	0,				// K_DATE_DISP
+	KF_FLASH_01 | KF_REPEAT,	// K_SET_MONTH
+	KF_FLASH_23 | KF_REPEAT,	// K_SET_DAY
+	0,				// K_YEAR_DISP
+	KF_FLASH_23 | KF_REPEAT,	// K_SET_YEAR
+	0,				// K_WEEKDAY_DISP
+	0,				// K_MESSAGE_DISP
+	KF_S2_MODE,			// K_SECONDS_DISP
+	KF_FLASH_01 | KF_FLASH_23 | KF_S2_MODE,	// K_ALARM
+	0,				// K_STATS
+	KF_FLASH_01 | KF_REPEAT,	// K_SET_ALARM_HOUR
+	KF_FLASH_23 | KF_REPEAT,	// K_SET_ALARM_MINUTE
+	0				// K_SET_ALARM_ON
+};
+
+const uint8_t kmode_dmode[] = {
+	M_NORMAL,		// K_NORMAL
+	M_NORMAL,		// K_SET_HOUR
+	M_NORMAL,		// K_SET_MINUTE
+	M_SET_HOUR_12_24,	// K_SET_HOUR_12_24
+	M_SET_BRIGHT,		// K_SET_BRIGHT
+	M_DATE_DISP,		// K_DATE_DISP
+	M_DATE_DISP,		// K_SET_MONTH
+	M_DATE_DISP,		// K_SET_DAY
+	M_YEAR_DISP,		// K_YEAR_DISP
+	M_YEAR_DISP,		// K_SET_YEAR
+	M_WEEKDAY_DISP,		// K_WEEKDAY_DISP
+	M_MESSAGE_DISP,		// K_MESSAGE_DISP
+	M_SECONDS_DISP,		// K_SECONDS_DISP
+	M_NORMAL,		// K_ALARM
+	M_STATS,		// K_STATS
+	M_SET_ALARM,		// K_SET_ALARM_HOUR
+	M_SET_ALARM,		// K_SET_ALARM_MINUTE
+	M_SET_ALARM_ON		// K_SET_ALARM_ON
+};
+
+const uint8_t kmode_s1_short[] = {
+	K_DATE_DISP,		// K_NORMAL
+	K_SET_MINUTE,		// K_SET_HOUR
+	K_SET_HOUR_12_24,	// K_SET_MINUTE
+	K_SET_BRIGHT,		// K_SET_HOUR_12_24
+	K_SET_ALARM_HOUR,	// K_SET_BRIGHT
+	K_YEAR_DISP,		// K_DATE_DISP
+	K_SET_DAY,		// K_SET_MONTH
+	K_DATE_DISP,		// K_SET_DAY
+	K_WEEKDAY_DISP,		// K_YEAR_DISP
+	K_YEAR_DISP,		// K_SET_YEAR
+	K_NORMAL,		// K_WEEKDAY_DISP
+	K_NORMAL,		// K_MESSAGE_DISP
+	K_NORMAL,		// K_SECONDS_DISP
+	K_NORMAL,		// K_ALARM
+	K_NORMAL,		// K_STATS
+	K_SET_ALARM_MINUTE,	// K_SET_ALARM_HOUR
+	K_SET_ALARM_ON,		// K_SET_ALARM_MINUTE
+	K_NORMAL		// K_SET_ALARM_ON
+};
+
+const uint8_t kmode_s1_long[] = {
+	K_SET_HOUR,		// K_NORMAL
+	K_SET_MINUTE,		// K_SET_HOUR
+	K_SET_HOUR_12_24,	// K_SET_MINUTE
+	K_SET_BRIGHT,		// K_SET_HOUR_12_24
+	K_SET_ALARM_HOUR,	// K_SET_BRIGHT
+	K_SET_MONTH,		// K_DATE_DISP
+	K_SET_DAY,		// K_SET_MONTH
+	K_DATE_DISP,		// K_SET_DAY
+	K_SET_YEAR,		// K_YEAR_DISP
+	K_YEAR_DISP,		// K_SET_YEAR
+	K_STATS,		// K_WEEKDAY_DISP
+	K_NORMAL,		// K_MESSAGE_DISP
+	K_NORMAL,		// K_SECONDS_DISP
+	K_NORMAL,		// K_ALARM
+	K_NORMAL,		// K_STATS
+	K_SET_ALARM_MINUTE,	// K_SET_ALARM_HOUR
+	K_SET_ALARM_ON,		// K_SET_ALARM_MINUTE
+	K_NORMAL		// K_SET_ALARM_ON
+};
+
+// only used by KF_S2_MODE rows
+const uint8_t kmode_s2_next[] = {
+	K_SECONDS_DISP,		// K_NORMAL
+	K_NORMAL,		// K_SET_HOUR
+	K_NORMAL,		// K_SET_MINUTE
+	K_NORMAL,		// K_SET_HOUR_12_24
+	K_NORMAL,		// K_SET_BRIGHT
+	K_NORMAL,		// K_DATE_DISP
+	K_NORMAL,		// K_SET_MONTH
+	K_NORMAL,		// K_SET_DAY
+	K_NORMAL,		// K_YEAR_DISP
+	K_NORMAL,		// K_SET_YEAR
+	K_NORMAL,		// K_WEEKDAY_DISP
+	K_NORMAL,		// K_MESSAGE_DISP
+	K_NORMAL,		// K_SECONDS_DISP
+	K_NORMAL,		// K_ALARM
+	K_NORMAL,		// K_STATS
+	K_NORMAL,		// K_SET_ALARM_HOUR
+	K_NORMAL,		// K_SET_ALARM_MINUTE
+	K_NORMAL		// K_SET_ALARM_ON
+};
+
+// a field of rtc_table stepped by button 2, or the action run instead
+const uint8_t kmode_s2_field[] = {
+	DS_FIELD_NONE,		// K_NORMAL
+	DS_FIELD_HOUR,		// K_SET_HOUR
+	DS_FIELD_MINUTES,	// K_SET_MINUTE
+	DS_FIELD_NONE,		// K_SET_HOUR_12_24
+	DS_FIELD_NONE,		// K_SET_BRIGHT
+	DS_FIELD_NONE,		// K_DATE_DISP
+	DS_FIELD_MONTH,		// K_SET_MONTH
+	DS_FIELD_DAY,		// K_SET_DAY
+	DS_FIELD_NONE,		// K_YEAR_DISP
+	DS_FIELD_YEAR,		// K_SET_YEAR
+	DS_FIELD_NONE,		// K_WEEKDAY_DISP
+	DS_FIELD_NONE,		// K_MESSAGE_DISP
+	DS_FIELD_NONE,		// K_SECONDS_DISP
+	DS_FIELD_NONE,		// K_ALARM
+	DS_FIELD_NONE,		// K_STATS
+	DS_FIELD_NONE,		// K_SET_ALARM_HOUR
+	DS_FIELD_NONE,		// K_SET_ALARM_MINUTE
+	DS_FIELD_NONE		// K_SET_ALARM_ON
+};
+
+void (* const kmode_s2_action[])(void) = {
+	0,			// K_NORMAL
+	0,			// K_SET_HOUR
+	0,			// K_SET_MINUTE
+	ds_hours_12_24_toggle,	// K_SET_HOUR_12_24
+	brightness_incr,	// K_SET_BRIGHT
+	0,			// K_DATE_DISP
+	0,			// K_SET_MONTH
+	0,			// K_SET_DAY
+	0,			// K_YEAR_DISP
+	0,			// K_SET_YEAR
+	0,			// K_WEEKDAY_DISP
+	0,			// K_MESSAGE_DISP
+	0,			// K_SECONDS_DISP
+	0,			// K_ALARM
+	stats_next,		// K_STATS
+	alarm_hour_incr,	// K_SET_ALARM_HOUR
+	alarm_minute_incr,	// K_SET_ALARM_MINUTE
+	alarm_on_next		// K_SET_ALARM_ON
+};
+
 void main(void)
 {
 	uint8_t gp_int1 = 0,	// general purpose integers
 	        gp_int2 = 0,
 			gp_int3 = 0;	
-	uint8_t disp_buf[4];	// secondary display buffer
 	uint8_t msg_pos = 0;	// track message position
-
-	// size of message
-	uint8_t msg_len = sizeof(secret_msg)/sizeof(secret_msg[0]);
+	uint8_t ev;		// button event
 
 	// setup the system
 	sys_init();
@@ -325,476 +734,354 @@ void main(void)
 	while(1)
 	{
 
-		// delay the loop to execute only once every 100ms
-		_delay_ms(100);
+		// wait for the next 100ms tick or a button event; sleep in between
+		loop_wait();
+
+		// things done once every 100ms
+		if (loop_tick) {
+			loop_tick = 0;
+
+			// check power down counter
+			if (display_show_counter / 10 > (kmode == K_ALARM ? ALARM_SECONDS : display_show_seconds))
+			{
+				// don't sleep on a half set clock
+				ds_commit();
+
+				// clear display
+				clearTmpDisplay();
+				updateTmpDisplay();
+				P3 &= 0x0F;
+
+				// the display is dark: check the battery for the next wake,
+				// off the wake-up path, and save the usage counters now and
+				// then. no flash writes on a nearly flat battery
+				battery_update();
+				if (battery_level < BATTERY_LEVELS - 1) {
+					stats_flush();
+				}
 
-		// check power down counter
-		if (display_show_counter / 10 > display_show_seconds)
-		{
-			// clear display
-			clearTmpDisplay();
-			updateTmpDisplay();
-			//_delay_ms(10);	// give the display refresh timer a chance to clear the display
-			P3 &= 0x0F;
-
-			// enable external interrupt
-			EX1 = 1;
-
-			// set clock pins to HIGH
-			// this reduces current draw from ~.75mA to ~.35mA while in powered down mode
-			// need to research this more to fully understand WHY
-			//DS_IO = DS_SCLK = DS_CE = 1;
-
-			// set DS1302 pins to high impedance mode
-			// P0_0, P0_1, P3_2
-			// this reduces current draw to ~.30mA in PDM!
-			P0M1 |= 0x03;
-			P3M1 |= 0x04;
-
-			// go to sleep
-			PCON |= 0x02;
-
-			// wakeup; NOPs required per MCU datasheet for returning from power down mode
-			_nop_();
-			_nop_();
-			_nop_();
-			_nop_();
-
-			// disable external interrupt; so we can use it as a regular button
-			EX1 = 0;
-
-			// set DS1302 pins to quasi-bidirectional mode
-			//P0M0 &= 0xFC;
-			P0M1 &= 0xFC;
-			//P3M0 &= 0xFB;
-			P3M1 &= 0xFB;
-
-			// this seems to prevent coming out of sleep and going right into
-			// display date mode. 
-			_delay_ms(100);
-
-			// start back up in time mode
-			change_kmode( K_NORMAL );
-
-			// reset counter (timer) until next power down
-			display_show_counter = 0;
-		}
+				// enable external interrupt; drop any edge latched while it was disabled
+				wake_sw1 = 0;
+				IE1 = 0;
+				EX1 = 1;
 
-		// read clock data
-		ds_readburst();
+				// put the pins in their power down state; see pins.c
+				pins_set(PINS_DISPLAY_OFF);
 
-		// control when the colon should blink: ever other second
-		display_colon = rtc_table[DS_ADDR_SECONDS]&DS_MASK_SECONDS_UNITS % 2;
+				// go to sleep. with the alarm or chime on, the wake-up timer wakes
+				// the MCU now and then to check them; it goes straight back to
+				// sleep unless one is due or SW1 was pressed. see alarm.h
+				alarm_timer_start();
+				do {
+					hal_power_down();
 
-		// manage actions based on button input, if any
-		switch (kmode) {
+					// wakeup; NOPs required per MCU datasheet for returning from power down mode
+					_nop_();
+					_nop_();
+					_nop_();
+					_nop_();
 
-			case K_SET_HOUR:
+					gp_int2 = wake_sw1 ? ALARM_NONE : alarm_check();
+				} while (!wake_sw1 && gp_int2 == ALARM_NONE);
+				alarm_timer_stop();
 
-				// flash the hours digit every other loop
-				flash_01 = !flash_01;
+				// disable external interrupt; so we can use it as a regular button
+				EX1 = 0;
 
-				// check button ready state
-				button_ready_check();
-
-				// Detect request to change mode (button 1 press and release)
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode( K_SET_MINUTE );
-				} else
-
-				// only change values when only button 2 is pressed
-				if (S2_READY_PRESSED && S2_PRESSED && !S1_PRESSED) {
-
-					// keep incrementing if button is held down for a long time
-					if (S2_LONG && flash_01) {
-						ds_hours_incr();
-	
-					// register a single button press and reset the ready state
-					// so we can detect more button presses
-					} else if (S2_READY) {
-						ds_hours_incr();
-						S2_READY = 0;		// reset S2_READY to prevent triggering multiple times
-						             		// during short button press.
-					}
-				}
-				break;
+				// bring the DS1302 bus back up and show the time straight away;
+				// the rest of this loop pass renders the first frame
+				pins_set(PINS_DISPLAY_ON);
 
-			case K_SET_MINUTE:
-				flash_23 = !flash_23;
-				button_ready_check();
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode( K_SET_HOUR_12_24 ); 
-				} else if (S2_READY_PRESSED && S2_PRESSED && !S1_PRESSED) {
-					if (S2_LONG && flash_23) {
-						ds_minutes_incr();
-					} else if (S2_READY) {
-						ds_minutes_incr();
-						S2_READY = 0;
-					}
-				} 
-				break;
+				// the clock kept running while we slept
+				ds_sync();
 
-			case K_SET_HOUR_12_24:
-				dmode = M_SET_HOUR_12_24;
-				button_ready_check();
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode(K_NORMAL);
-				} 
-				if (S2_READY && S2_PRESSED && !S1_PRESSED) {
-					ds_hours_12_24_toggle();
-					S2_READY = 0;
-				} 
-				break;
-
-			case K_DATE_DISP:
-				dmode = M_DATE_DISP;
-				button_ready_check();
-				if (S1_READY_PRESSED && !S2_PRESSED) {
-					if (S1_LONG) {
-						change_kmode(K_SET_MONTH);
-					} else if (!S1_PRESSED) {
-						change_kmode(K_YEAR_DISP);
-					}
-				}
+				// start back up in time mode, flashing for the alarm
+				change_kmode(gp_int2 == ALARM_FIRE ? K_ALARM : K_NORMAL);
+				stats_wake();
 
-				// Button 2 does nothing in this mode
-//				if (S2_READY_PRESSED && !S1_PRESSED) {						
-//				}
+				// reset counter (timer) until next power down; the chime only
+				// shows the time for CHIME_SECONDS
+				display_show_counter = gp_int2 == ALARM_CHIME ? (display_show_seconds + 1 - CHIME_SECONDS) * 10 : 0;
+			}
 
-				break;
+			// keep clock data current; the DS1302 is only read around the seconds edge
+			ds_tick();
 
-			case K_SET_MONTH:
-				flash_01 = !flash_01;
-				button_ready_check();
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode(K_SET_DAY);
-				} else if (S2_READY_PRESSED && S2_PRESSED && !S1_PRESSED) {
-					if (S2_LONG && flash_01) {
-						ds_month_incr();
-					} else if (S2_READY) {
-						ds_month_incr();
-						S2_READY = 0;
-					}
-				}
-				break;
+			// display time in this mode
+			stats_tick(kmode);
 
-			case K_SET_DAY:
-				flash_23 = !flash_23;
-				button_ready_check();
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode(K_DATE_DISP); 
-				} else if (S2_READY_PRESSED && S2_PRESSED && !S1_PRESSED) {
-					if (S2_LONG && flash_23) {
-						ds_day_incr();
-					} else if (S2_READY) {
-						ds_day_incr();
-						S2_READY = 0;
-					}
-				} 
-				break;
-
-			case K_YEAR_DISP:
-				dmode = M_YEAR_DISP;
-				button_ready_check();
-				if (S1_READY_PRESSED && !S2_PRESSED) {
-					if (S1_LONG) {
-						change_kmode(K_SET_YEAR);
-					} else if (!S1_PRESSED) {
-						change_kmode(K_WEEKDAY_DISP);
-					}
-				}
-				break;
+			// control when the colon should blink: ever other second
+			display_colon = rtc_table[DS_ADDR_SECONDS]&DS_MASK_SECONDS_UNITS % 2;
 
-			case K_SET_YEAR:
+			// flash the digits being set every other loop
+			gp_int3 = kmode_flags[kmode];
+			if (gp_int3 & KF_FLASH_01) {
+				flash_01 = !flash_01;
+			}
+			if (gp_int3 & KF_FLASH_23) {
 				flash_23 = !flash_23;
-				button_ready_check();
-				if (S1_READY_PRESSED && (S1_LONG || !S1_PRESSED) && !S2_PRESSED) {
-					change_kmode(K_YEAR_DISP); 
-				} else if (S2_READY_PRESSED && S2_PRESSED && !S1_PRESSED) {
-					if (S2_LONG && flash_23) {
-						ds_year_incr();
-					} else if (S2_READY) {
-						ds_year_incr();
-						S2_READY = 0;
-					}
-				} 
-				break;
-
-			case K_WEEKDAY_DISP:
-				dmode = M_WEEKDAY_DISP;
-				button_ready_check();
-				if (S1_READY_PRESSED && !S1_PRESSED && !S2_PRESSED) {
+			}
+
+			// display secret message; this will control the speed at which it scrolls
+			if (kmode == K_MESSAGE_DISP && gp_int1++ % MSG_SCROLL_SPEED == 0) {
+
+				// the message has finished displaying, now what?
+				if (msg_pos > STR_SECRET_LEN + 4) {
+					// the message has completed. the screen is blank. now what?
+					// display the message again? Then reset the message position
+					//
+					//msg_pos = 0;
+					//
+					// want to display the message again, but this time let the screen go
+					// to sleep? then set display_show_counter to MSG_SCROLL_SPEED.
+					//
+					//display_show_counter = MSG_SCROLL_SPEED;
+					//
+					// or perhaps just go back to displaying the current time. this feels the most
+					// natural option to me. 
 					change_kmode(K_NORMAL);
-				}
-				break;
-
-			// display secret message
-			// pressing left button will exit this mode
-			case K_MESSAGE_DISP:
-				dmode = M_MESSAGE_DISP;
-				button_ready_check();
-				if (S1_READY_PRESSED && !S1_PRESSED && !S2_PRESSED) {
-					change_kmode(K_NORMAL);
-				}
-				break;
-
-			// debug mode; just shows button state (Sx_LONG and Sx_PRESSED)
-/*			case K_DEBUG:
-				dmode = M_DEBUG;
-				button_ready_check();
-				if (S2_READY_PRESSED && !S1_PRESSED) {
-					if (S2_LONG && !S2_PRESSED) {
-						change_kmode(K_NORMAL);
-					}
-				}
-				if (S1_READY_PRESSED && !S2_PRESSED) {
-					if (S1_LONG && !S1_PRESSED) {
-						change_kmode(K_NORMAL);
-					}
-				}
-				break;
-*/
-			case K_NORMAL:
-			default:
-				dmode = M_NORMAL;
-
-				button_ready_check();
 
-				// Below is a basic button handler template.
-				// It could perhaps be turned into its own function
-				// but that might get messy.
-
-				// ** BUTTON ONE **
-				if (S1_READY_PRESSED && !S2_PRESSED) {
+					// but should the watch wait the full timeout or do you want the time to disappear
+					// more quickly since the watch has already been on for the length of the message?
+					// here's how you'd cut that timeout value in half
+					//
+					//display_show_counter = display_show_seconds * 5
+				} else {
 
-					// change mode after long button press is released
-//					if (S1_LONG && !S1_PRESSED) {
-//						change_kmode( K_SET_HOUR );
-//					} else
+					// reset the display counter every time through so the full message is displayed
+					// the check against MSG_SCROLL_SPEED is to provide a mechanism to allow the display
+					// to go to sleep during message scroll if you want
+					//if (display_show_counter < MSG_SCROLL_SPEED) {
+						display_show_counter = 0;
+					//}
 
-					// change mode immediately on long button press
-					if (S1_LONG) {
-						change_kmode( K_SET_HOUR );
-					} else
+					// increment the message position; the display has to follow
+					msg_pos++;
+					display_dirty = 1;
+				}
+			}
 
-					// change mode on short button press
-					if (!S1_PRESSED) {
-						change_kmode( K_DATE_DISP );
-					}
-				} else
-
-				// ** BUTTON TWO ***
-/*				if (S2_READY_PRESSED && !S1_PRESSED) {
-
-					// change mode after long button press is released
-					if (S2_LONG && !S2_PRESSED) { 
-						change_kmode( K_DEBUG );	// if i make this K_SET_HOUR it goes a little nutty
-													// because of assumptions (button 2 never changes mode)
-													// but could i protect against that with Sx_READY_PRESSED ?
-					} else 
-
-					// change mode immediately on long button press
-//					if (S2_LONG) {
-//						change_kmode( K_SET_HOUR );
-//					} else
-
-					// change mode on short button press
-					if (!S2_PRESSED) {
-						change_kmode( K_DEBUG );
-					}
-				} else
-*/
-				// both buttons at the same time 
-				if (S2_READY_PRESSED && S2_LONG && S1_READY_PRESSED && S1_LONG) {
+			// reset the display timer during user interaction
+			// otherwise increment it
+			display_show_counter = S1_PRESSED || S2_PRESSED ? 0 : display_show_counter + 1;
+		}
 
-					// not really necessary, but message might pop up sooner than intended
-					gp_int1 = 0;
+		// manage actions based on button events, if any; see the keyboard mode table
+		while ((ev = ev_get()) != EV_NONE) {
+			gp_int2 = kmode;
+			gp_int3 = kmode_flags[gp_int2];
 
-					// reset message display position before switching to message display mode
-					msg_pos = 0;
-					change_kmode( K_MESSAGE_DISP );
-				}
-				break;
-		}
+			switch (ev) {
 
-		// clear temporary display buffer
-		clearTmpDisplay();
+				// ** BUTTON ONE **
+				// change mode on a short press and release, or right away on a long press
+				case EV_S1 | EV_SHORT:
+					change_kmode(kmode_s1_short[gp_int2]);
+					break;
 
-		// based on current display state of watch, update temporary buffer
-		switch (dmode) {
+				case EV_S1 | EV_LONG:
+					change_kmode(kmode_s1_long[gp_int2]);
+					break;
 
-			// display the secret message
-			case M_MESSAGE_DISP:
+				// ** BOTH BUTTONS **
+				case EV_CHORD:
+					if (gp_int3 & KF_CHORD) {
 
-				// this will control the speed at which the message will scroll
-				if (gp_int1++ % MSG_SCROLL_SPEED == 0) {
+						// not really necessary, but message might pop up sooner than intended
+						gp_int1 = 0;
 
-					// unsigned int, so gp_int2 becomes 255 when decrementing 0
-					for (gp_int2=3; gp_int2<4; gp_int2--) {
+						// reset message display position before switching to message display mode
+						msg_pos = 0;
+						change_kmode( K_MESSAGE_DISP );
+					}
+					break;
 
-						// calculate what character from the message goes into what position on the screen
-						disp_buf[3-gp_int2] = (msg_pos > gp_int2) && msg_pos < (msg_len + gp_int2 + 1) ? secret_msg[msg_pos-gp_int2-1] : LED_BLANK;
+				// ** BUTTON TWO **
+				// run the action once per press; keep running it while the button is held down
+				case EV_S2 | EV_REPEAT:
+					if (!(gp_int3 & KF_REPEAT)) {
+						break;
+					}
+					// fall through
+				case EV_S2 | EV_PRESS:
+					if (gp_int3 & KF_S2_MODE) {
+						break;
 					}
+					if (kmode_s2_field[gp_int2] != DS_FIELD_NONE) {
+						ds_field_incr(kmode_s2_field[gp_int2]);
+					} else if (kmode_s2_action[gp_int2]) {
+						kmode_s2_action[gp_int2]();
+					}
+					display_dirty = 1;
+					break;
+
+				// or change mode after the button is released. a long press goes back
+				// to K_NORMAL, as it's likely the start of the secret message.
+				case EV_S2 | EV_SHORT:
+				case EV_S2 | EV_LONG:
+					if (gp_int3 & KF_S2_MODE) {
+						change_kmode(ev == (EV_S2 | EV_SHORT) ? kmode_s2_next[gp_int2] : K_NORMAL);
+					}
+					break;
+			}
+		}
+		dmode = kmode_dmode[kmode];
 
-					// the message has finished displaying, now what?
-					if (msg_pos > msg_len + 4) {
-						// the message has completed. the screen is blank. now what?
-						// display the message again? Then reset the message position
-						//
-						//msg_pos = 0;
-						//
-						// want to display the message again, but this time let the screen go
-						// to sleep? then set display_show_counter to MSG_SCROLL_SPEED.
-						//
-						//display_show_counter = MSG_SCROLL_SPEED;
-						//
-						// or perhaps just go back to displaying the current time. this feels the most
-						// natural option to me. 
-						change_kmode(K_NORMAL);
-
-						// but should the watch wait the full timeout or do you want the time to disappear
-						// more quickly since the watch has already been on for the length of the message?
-						// here's how you'd cut that timeout value in half
-						//
-						//display_show_counter = display_show_seconds * 5
-					} 
-					else
+		// the mode, flashing digits and colon are display inputs too
+		gp_int3 = dmode | (flash_01 ? 0x10 : 0) | (flash_23 ? 0x20 : 0) | (display_colon ? 0x40 : 0);
+		if (gp_int3 != display_state) {
+			display_state = gp_int3;
+			display_dirty = 1;
+		}
 
-					// reset the display counter every time through so the full message is displayed
-					// the check against MSG_SCROLL_SPEED is to provide a mechanism to allow the display
-					// to go to sleep during message scroll if you want
-					//if (display_show_counter < MSG_SCROLL_SPEED) {
-						display_show_counter = 0;
-					//}
+		// so is new clock data
+		if (ds_updated) {
+			ds_updated = 0;
+			display_dirty = 1;
+		}
 
-					// increment the message position
-					msg_pos++;
-				}
+		// only rebuild the display when something it shows has changed
+		if (display_dirty) {
+			display_dirty = 0;
 
-				// put on the display whatever is in disp_buf;
-				filldisplay( 0, disp_buf[0], 0);
-				filldisplay( 1, disp_buf[1], 0);
-				filldisplay( 2, disp_buf[2], 0);
-				filldisplay( 3, disp_buf[3], 0);
-				break;
-
-			case M_WEEKDAY_DISP:
-				switch(rtc_table[DS_ADDR_WEEKDAY]) {
-					case 1:
-						disp_buf[1] = LED_S;
-						disp_buf[2] = LED_u;
-						disp_buf[3] = LED_n;
-						break;
-					case 2:
-						disp_buf[1] = LED_M;
-						disp_buf[2] = LED_o;
-						disp_buf[3] = LED_n;
-						break;
-					case 3:
-						disp_buf[1] = LED_t;
-						disp_buf[2] = LED_u;
-						disp_buf[3] = LED_E;
-						break;
-					case 4:
-						disp_buf[1] = LED_W;
-						disp_buf[2] = LED_E;
-						disp_buf[3] = LED_d;
-						break;
-					case 5:
-						disp_buf[1] = LED_t;
-						disp_buf[2] = LED_h;
-						disp_buf[3] = LED_u;
-						break;
-					case 6:
-						disp_buf[1] = LED_F;
-						disp_buf[2] = LED_r;
-						disp_buf[3] = LED_i;
-						break;
-					case 7:
-						disp_buf[1] = LED_S;
-						disp_buf[2] = LED_A;
-						disp_buf[3] = LED_t;
-						break;
-					default:
-						disp_buf[1] = LED_DASH;
-						disp_buf[2] = rtc_table[DS_ADDR_WEEKDAY];
-						disp_buf[3] = LED_DASH;
-						break;
-				}
-				filldisplay( 1, disp_buf[1], 0);
-				filldisplay( 2, disp_buf[2], 0);
-				filldisplay( 3, disp_buf[3], 0);
-				break;
-
-			case M_YEAR_DISP:
-				// the DS1302 only maintains a 2 digit year (2000 - 2100); so 20 of 20xx is hard-coded
-				filldisplay( 0, 2, 0);
-				filldisplay( 1, 0, 0);
-				if (!flash_23) {
-					filldisplay( 2, rtc_table[DS_ADDR_YEAR]>>4, 0);
-					filldisplay( 3, rtc_table[DS_ADDR_YEAR]&DS_MASK_YEAR_UNITS, 0);
-				}
-				break;
+			// clear temporary display buffer
+			clearTmpDisplay();
 
-			case M_DATE_DISP:
-				// month
-				if (!flash_01) {
-					filldisplay( 0, rtc_table[DS_ADDR_MONTH]>>4, 0);					// tenmonth ( &MASK_TENS useless, as MSB bits are read as '0')
-					filldisplay( 1, rtc_table[DS_ADDR_MONTH]&DS_MASK_MONTH_UNITS, 1);
-				}
+			// based on current display state of watch, update temporary buffer
+			switch (dmode) {
+
+				// display the secret message
+				case M_MESSAGE_DISP:
+
+					// scroll in from the right, one position per msg_pos step
+					text_draw(STR_SECRET, 4 - msg_pos);
+					break;
+
+				case M_WEEKDAY_DISP:
+					// DS1302 weekday 1..7; anything else is shown as a number
+					gp_int2 = rtc_table[DS_ADDR_WEEKDAY] - 1;
+					if (gp_int2 < 7) {
+						text_draw(ee_str(STR_WEEKDAY + gp_int2), 1);
+					} else {
+						filldisplay( 1, LED_DASH, 0);
+						filldisplay( 2, rtc_table[DS_ADDR_WEEKDAY], 0);
+						filldisplay( 3, LED_DASH, 0);
+					}
+					break;
+
+				case M_YEAR_DISP:
+					// the DS1302 only maintains a 2 digit year (2000 - 2100); so 20 of 20xx is hard-coded
+					filldisplay( 0, 2, 0);
+					filldisplay( 1, 0, 0);
+					if (!flash_23) {
+						filldisplay( 2, rtc_table[DS_ADDR_YEAR]>>4, 0);
+						filldisplay( 3, rtc_table[DS_ADDR_YEAR]&DS_MASK_YEAR_UNITS, 0);
+					}
+					break;
 
-				// day 
-				if (!flash_23) {
-					filldisplay( 2, rtc_table[DS_ADDR_DAY]>>4, 0);						// tenday   ( &MASK_TENS useless)
-					filldisplay( 3, rtc_table[DS_ADDR_DAY]&DS_MASK_DAY_UNITS, 0);		// day       
-				}
-				break;
+				case M_DATE_DISP:
+					// month
+					if (!flash_01) {
+						filldisplay( 0, rtc_table[DS_ADDR_MONTH]>>4, 0);					// tenmonth ( &MASK_TENS useless, as MSB bits are read as '0')
+						filldisplay( 1, rtc_table[DS_ADDR_MONTH]&DS_MASK_MONTH_UNITS, 1);
+					}
 
-			case M_SET_HOUR_12_24:
-				if (H12_24) {
-					filldisplay(0, 1, 0);
-					filldisplay(1, 2, 0);
-				} else {
-					filldisplay(0, 2, 0);
-					filldisplay(1, 4, 0);
-				}
-				filldisplay(2, LED_h, 0);
-				filldisplay(3, LED_r, 0);
-				break;
-
-/*			case M_DEBUG:
-				filldisplay(1, S1_PRESSED, 0);
-				filldisplay(0, S1_LONG, 0);
-				filldisplay(3, S2_PRESSED, 0);
-				filldisplay(2, S2_LONG, 0);
-				break;
+					// day 
+					if (!flash_23) {
+						filldisplay( 2, rtc_table[DS_ADDR_DAY]>>4, 0);						// tenday   ( &MASK_TENS useless)
+						filldisplay( 3, rtc_table[DS_ADDR_DAY]&DS_MASK_DAY_UNITS, 0);		// day       
+					}
+					break;
+
+				case M_SET_HOUR_12_24:
+					text_draw(H12_24 ? STR_HR12 : STR_HR24, 0);
+					break;
+
+				// brightness shown as 8 (brightest) down to 1
+				case M_SET_BRIGHT:
+					text_draw(STR_BRIGHT, 0);
+					filldisplay(3, BRIGHT_LEVELS - (cfg_table[CFG_BRIGHT_BYTE] >> CFG_BRIGHT_SHIFT), 0);
+					break;
+
+				// alarm time, in the clock's 12/24 hour mode
+				case M_SET_ALARM:
+					gp_int2 = bcd_from_bin(cfg_table[CFG_ALARM_HOURS_BYTE] >> CFG_ALARM_HOURS_SHIFT);
+					gp_int3 = 0;
+					if (H12_24) {
+						gp_int2 = bcd_24to12(gp_int2);
+						gp_int3 = gp_int2 & BCD_PM;
+						gp_int2 &= DS_MASK_HOUR12;
+					}
+					if (!flash_01) {
+						filldisplay( 0, (gp_int2 >> 4 ? gp_int2 >> 4 : LED_BLANK), 0);
+						filldisplay( 1, gp_int2 & 0x0F, 1);
+					}
+					if (!flash_23) {
+						gp_int2 = bcd_from_bin(cfg_table[CFG_ALARM_MINUTES_BYTE] & CFG_ALARM_MINUTES_MASK);
+						filldisplay( 2, gp_int2 >> 4, 0);
+						filldisplay( 3, gp_int2 & 0x0F, gp_int3);
+					}
+					break;
+
+				// what is on: neither, the alarm, the chime or both
+				case M_SET_ALARM_ON:
+					text_draw(ee_str(STR_ALARM_ON + alarm_on()), 0);
+					break;
+
+				// the counter name and its count, every other second
+				case M_STATS:
+					if (display_colon) {
+						gp_int2 = stats_item < STATS_KMODE ? stats_item : STATS_KMODE;
+						text_draw(ee_str(STR_STATS + gp_int2), 0);
+						if (stats_item >= STATS_KMODE) {
+							gp_int2 = bcd_from_bin(stats_item - STATS_KMODE);
+							filldisplay(2, gp_int2 >> 4, 0);
+							filldisplay(3, gp_int2 & 0x0F, 0);
+						}
+					} else {
+						number_draw(stats[stats_item]);
+					}
+					break;
+
+				case M_SECONDS_DISP:
+					filldisplay( 0, (rtc_table[DS_ADDR_MINUTES]>>4)&(DS_MASK_MINUTES_TENS>>4), 0);
+					filldisplay( 1, rtc_table[DS_ADDR_MINUTES]&DS_MASK_MINUTES_UNITS, 1);
+					filldisplay( 2, (rtc_table[DS_ADDR_SECONDS]>>4)&(DS_MASK_SECONDS_TENS>>4), 0);
+					filldisplay( 3, rtc_table[DS_ADDR_SECONDS]&DS_MASK_SECONDS_UNITS, 0);
+					break;
+
+/*				case M_DEBUG:
+					filldisplay(1, S1_PRESSED, 0);
+					filldisplay(0, S1_LONG, 0);
+					filldisplay(3, S2_PRESSED, 0);
+					filldisplay(2, S2_LONG, 0);
+					break;
 */
-			case M_NORMAL:
-			default:
-				if (!flash_01) {
-					if (!H12_24) {
-
-						// don't display a 0 in the tens position
-						gp_int1 = (rtc_table[DS_ADDR_HOUR]>>4)&(DS_MASK_HOUR24_TENS>>4);
-						filldisplay( 0, (gp_int1<1?LED_BLANK:gp_int1), 0);
-					} else if (H12_TH) {
-						filldisplay( 0, 1, 0);						
+				case M_NORMAL:
+				default:
+					if (!flash_01) {
+						if (!H12_24) {
+
+							// don't display a 0 in the tens position
+							gp_int1 = (rtc_table[DS_ADDR_HOUR]>>4)&(DS_MASK_HOUR24_TENS>>4);
+							filldisplay( 0, (gp_int1<1?LED_BLANK:gp_int1), 0);
+						} else if (H12_TH) {
+							filldisplay( 0, 1, 0);						
+						}
+						filldisplay( 1, rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR_UNITS, display_colon);
 					}
-					filldisplay( 1, rtc_table[DS_ADDR_HOUR]&DS_MASK_HOUR_UNITS, display_colon);
-				}
-				if (!flash_23) {
-					filldisplay( 2, (rtc_table[DS_ADDR_MINUTES]>>4)&(DS_MASK_MINUTES_TENS>>4), 0);
-					filldisplay( 3, rtc_table[DS_ADDR_MINUTES]&DS_MASK_MINUTES_UNITS, H12_24 & H12_PM);
-				}
-				break;
-		}
-
-		// copy temporary display buffer to display buffer
-		__critical { updateTmpDisplay(); }
+					if (!flash_23) {
+						filldisplay( 2, (rtc_table[DS_ADDR_MINUTES]>>4)&(DS_MASK_MINUTES_TENS>>4), 0);
+						filldisplay( 3, rtc_table[DS_ADDR_MINUTES]&DS_MASK_MINUTES_UNITS, H12_24 & H12_PM);
+					}
+					// low battery indicator
+					dotdisplay(0, battery_level);
+					break;
+			}
 
-		// reset the display timer during user interaction
-		// otherwise increment it
-		display_show_counter = S1_PRESSED || S2_PRESSED ? 0 : display_show_counter + 1;
+			// copy temporary display buffer to display buffer
+			__critical { updateTmpDisplay(); }
+		}
 
 		// reset WDT
 		WDT_CLEAR();
@@ -0,0 +1,37 @@
+// Pin configuration per power state
+//
+// Port modes (PxM1:PxM0): 00 = quasi-bidirectional, 01 = push-pull,
+//                         10 = input only (high impedance), 11 = open drain
+//
+// P0.0 = DS_CE, P0.1 = DS_IO
+// P3.1 = SW2, P3.2 = DS_SCLK, P3.3 = SW1 (INT1), P3.4-P3.7 = LED anodes
+//
+
+#include "pins.h"
+
+const uint8_t pin_table[2][6] = {
+#ifndef DS_PUSHPULL
+	// stock board: DS1302 lines have 10k pull-ups to VCC and 40k pull-downs
+	// inside the DS1302; leaving them driven costs current against one or the other.
+	//  P0M0  P0M1  P3M0  P3M1  P0    P3
+	{   0x00, 0x00, 0xF0, 0x00, 0x02, 0x00 },	// PINS_DISPLAY_ON: DS_IO idles high
+	{   0x00, 0x03, 0xF0, 0x04, 0x00, 0x00 },	// PINS_DISPLAY_OFF: DS1302 lines high impedance (~.30mA)
+#else
+	// 10k pull-ups removed (see README): the DS1302 lines are push-pull. nothing pulls
+	// them up any more, so driving them low in power down draws no current.
+	// ds1302.c turns DS_IO into an input while reading.
+	//  P0M0  P0M1  P3M0  P3M1  P0    P3
+	{   0x03, 0x00, 0xF4, 0x00, 0x00, 0x00 },	// PINS_DISPLAY_ON
+	{   0x03, 0x00, 0xF4, 0x00, 0x00, 0x00 },	// PINS_DISPLAY_OFF: DS1302 lines driven low
+#endif
+};
+
+// levels are set before the modes so no pin glitches while switching
+void pins_set(uint8_t state) {
+	P0 = (P0 & ~PINS_P0_MASK) | pin_table[state][PINS_P0];
+	P3 = (P3 & ~PINS_P3_MASK) | pin_table[state][PINS_P3];
+	P0M0 = pin_table[state][PINS_P0M0];
+	P0M1 = pin_table[state][PINS_P0M1];
+	P3M0 = pin_table[state][PINS_P3M0];
+	P3M1 = pin_table[state][PINS_P3M1];
+}
@@ -0,0 +1,28 @@
+// Pin configuration per power state
+//
+// Mode and level of every pin that changes between power states is kept in
+// one table per board variant (pins.c) and applied by pins_set().
+//
+
+#include "hal.h"
+#include <stdint.h>
+
+// power states
+#define PINS_DISPLAY_ON   0	// running; LED anodes push-pull, DS1302 bus in use
+#define PINS_DISPLAY_OFF  1	// power down mode
+
+// columns of the pin table
+#define PINS_P0M0   0
+#define PINS_P0M1   1
+#define PINS_P3M0   2
+#define PINS_P3M1   3
+#define PINS_P0     4	// levels of the P0 pins in PINS_P0_MASK
+#define PINS_P3     5	// levels of the P3 pins in PINS_P3_MASK
+
+// pins whose level is part of the power state: DS_CE, DS_IO / DS_SCLK, LED anodes
+// P3.1 and P3.3 are the buttons and always stay high (quasi-bidirectional inputs)
+#define PINS_P0_MASK  0x03
+#define PINS_P3_MASK  0xF4
+
+// switch all pins to the given power state
+void pins_set(uint8_t state);
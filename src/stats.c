@@ -0,0 +1,90 @@
+// Usage counters; see stats.h
+//
+
+#include "stats.h"
+#include "eeprom.h"
+
+// PCON: power on flag, low voltage flag
+#define PCON_POF   0x10
+#define PCON_LVDF  0x20
+
+// 0x00 in the first and last byte of a record
+#define STATS_MARK  0x00
+
+__idata uint16_t stats[STATS_ITEMS];
+
+// next free record, STATS_SLOTS when the sector is full
+uint8_t stats_slot = 0;
+
+// wakes since the last flush, and 100ms ticks of the current second
+uint8_t stats_pending = 0;
+uint8_t stats_tenths = 0;
+
+static void stats_incr(uint8_t i) {
+    if (stats[i] != 0xFFFF)
+        stats[i]++;
+}
+
+void stats_init() {
+    uint16_t addr = EE_IAP(EE_LOG);
+    uint8_t slot, i;
+
+    for (slot = 0; slot < STATS_SLOTS; slot++, addr += STATS_RECORD_SIZE) {
+        i = ee_read(addr);
+        if (i == 0xFF)
+            break;
+        // not a record: erase the sector before the next flush
+        if (i != STATS_MARK) {
+            slot = STATS_SLOTS;
+            break;
+        }
+        if (ee_read(addr + STATS_RECORD_SIZE - 1) != STATS_MARK)
+            continue;
+        for (i = 0; i < STATS_ITEMS; i++)
+            stats[i] = ee_read(addr + 1 + 2 * i) | ee_read(addr + 2 + 2 * i) << 8;
+    }
+    stats_slot = slot;
+
+    // a low voltage reset leaves LVDF set; a power on sets POF as well
+    if ((PCON & (PCON_POF | PCON_LVDF)) == PCON_LVDF) {
+        stats_incr(STATS_BROWNOUTS);
+        stats_pending = STATS_FLUSH_WAKES;
+    }
+    PCON &= ~(PCON_POF | PCON_LVDF);
+}
+
+void stats_tick(uint8_t kmode) {
+    if (++stats_tenths == 10) {
+        stats_tenths = 0;
+        stats_incr(STATS_ON);
+        stats_incr(STATS_KMODE + (kmode < STATS_KMODES ? kmode : STATS_KMODES - 1));
+    }
+}
+
+void stats_wake() {
+    stats_incr(STATS_WAKES);
+    stats_pending++;
+}
+
+void stats_flush() {
+    uint16_t addr;
+    uint8_t i;
+
+    if (stats_pending < STATS_FLUSH_WAKES)
+        return;
+    stats_pending = 0;
+
+    if (stats_slot == STATS_SLOTS) {
+        ee_erase(EE_IAP(EE_LOG));
+        stats_slot = 0;
+    }
+    addr = EE_IAP(EE_LOG) + stats_slot * STATS_RECORD_SIZE;
+    stats_slot++;
+
+    ee_write(addr++, STATS_MARK);
+    for (i = 0; i < STATS_ITEMS; i++) {
+        ee_write(addr++, stats[i] & 0xFF);
+        ee_write(addr++, stats[i] >> 8);
+    }
+    ee_write(addr, STATS_MARK);
+}
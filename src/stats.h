@@ -0,0 +1,48 @@
+// Usage counters, kept in the data flash
+//
+// The counters live in RAM and are appended to the usage log sector of the
+// data flash (EE_LOG, see eeprom.h) every STATS_FLUSH_WAKES wakes. Each
+// record is a full copy of the counters, so the last complete record is
+// the current state and the sector only has to be erased when it is full:
+// once every STATS_SLOTS flushes. A record is marked used by its first
+// byte and complete by its last, both written as 0x00, so a record cut
+// short by a power loss is skipped.
+//
+
+#include "hal.h"
+#include <stdint.h>
+
+// keyboard modes counted; the last counter also takes the modes after it
+// in main.c (the alarm setting), which keeps a record at 40 bytes
+#define STATS_KMODES  16
+
+// counters, in the order of the display items
+#define STATS_WAKES      0	// display wakes
+#define STATS_ON         1	// seconds with the display on
+#define STATS_BROWNOUTS  2	// low voltage resets
+#define STATS_KMODE      3	// seconds in each keyboard mode from here on
+#define STATS_ITEMS      (STATS_KMODE + STATS_KMODES)
+
+#define STATS_FLUSH_WAKES  8
+
+// record layout: 0x00, the counters (little endian), 0x00
+#define STATS_RECORD_SIZE  (2 * STATS_ITEMS + 2)
+#define STATS_SLOTS        (EE_SECTOR_SIZE / STATS_RECORD_SIZE)
+
+// counters stop at 0xFFFF
+extern __idata uint16_t stats[STATS_ITEMS];
+
+// load the counters from the last complete record, and count a low
+// voltage reset
+void stats_init();
+
+// count 100ms of display time in a keyboard mode
+void stats_tick(uint8_t kmode);
+
+// count a display wake
+void stats_wake();
+
+// append the counters to the log if STATS_FLUSH_WAKES wakes were counted
+// since the last time (or after a low voltage reset). takes about 2ms, and
+// 20ms more when the sector has to be erased
+void stats_flush();
@@ -19,5 +19,17 @@ __sfr __at 0xB2 P3M0;
 __sfr __at 0xB1 P3M1;
 __sfr __at 0xC1 WDT_CONTR;
 __sfr __at 0x97 CLK_DIV;
+__sfr __at 0xAA WKTCL;
+__sfr __at 0xAB WKTCH;
+__sfr __at 0x9D P1ASF;
+__sfr __at 0xBC ADC_CONTR;
+__sfr __at 0xBD ADC_RES;
+__sfr __at 0xBE ADC_RESL;
+__sfr __at 0xC2 IAP_DATA;
+__sfr __at 0xC3 IAP_ADDRH;
+__sfr __at 0xC4 IAP_ADDRL;
+__sfr __at 0xC5 IAP_CMD;
+__sfr __at 0xC6 IAP_TRIG;
+__sfr __at 0xC7 IAP_CONTR;
 
 #endif
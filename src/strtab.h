@@ -0,0 +1,30 @@
+// generated by tools/mkstrtab.py from strtab.txt; do not edit
+//
+// see tools/mkstrtab.py for the format
+
+#define STRTAB_SIZE 86
+
+#define STR_SECRET         0	// "ruthSAriAn WAS HErE"
+#define STR_SECRET_LEN    19
+#define STR_HR12          19	// "12hr"
+#define STR_HR12_LEN       4
+#define STR_HR24          23	// "24hr"
+#define STR_HR24_LEN       4
+#define STR_BRIGHT        27	// "br"
+#define STR_BRIGHT_LEN     2
+#define STR_ALARM_ON      71	// 4 offsets
+#define STR_WEEKDAY       75	// 7 offsets
+#define STR_STATS         82	// 4 offsets
+
+#ifdef STRTAB_DATA
+__code const uint8_t __at (EE_STRTAB) strtab[STRTAB_SIZE] = {
+	0x72, 0x75, 0x74, 0x68, 0x53, 0x41, 0x72, 0x69, 0x41, 0x6E, 0x20, 0x57,
+	0x41, 0x53, 0x20, 0x48, 0x45, 0x72, 0xC5, 0x31, 0x32, 0x68, 0xF2, 0x32,
+	0x34, 0x68, 0xF2, 0x62, 0xF2, 0x6F, 0x46, 0xC6, 0x41, 0xCC, 0x43, 0xE8,
+	0x41, 0x4C, 0x43, 0xE8, 0x53, 0x75, 0xEE, 0x4D, 0x6F, 0xEE, 0x74, 0x75,
+	0xC5, 0x57, 0x45, 0xE4, 0x74, 0x68, 0xF5, 0x46, 0x72, 0xE9, 0x53, 0x41,
+	0xF4, 0x57, 0x41, 0x6B, 0xC5, 0x6F, 0xEE, 0x62, 0x72, 0xEE, 0xF4, 0x1D,
+	0x20, 0x22, 0x24, 0x28, 0x2B, 0x2E, 0x31, 0x34, 0x37, 0x3A, 0x3D, 0x41,
+	0x43, 0x46
+};
+#endif
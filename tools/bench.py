@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+#
+# Cycle benchmark for the watch firmware (make bench).
+#
+# Runs the simulator build of the firmware (-DSIM51, build/sim/main.ihx)
+# under ucsim/s51, drives the buttons through a few scripted
+# scenarios and reports how many clocks are spent per call in the hot
+# routines, in machine cycles of the simulated 8051 (see sim51.py for how
+# they relate to STC15 clocks). Results are compared against
+# tools/bench_baseline.json; run "make bench-baseline" to record a new
+# baseline after an intended change. A scenario without a baseline fails
+# the run. The baseline file is checked in without any scenarios: none has
+# been recorded from s51 yet, and until one is the run stops right away. The baseline file can also set a hard budget on the worst case
+# of a metric ("budgets"), which fails the run whatever the baseline says.
+#
+# Every routine is timed from its entry breakpoint to a temporary
+# breakpoint on its return address. Time spent in interrupts is taken out
+# of everything but the interrupt handlers themselves, so the numbers for
+# ds_readburst etc. do not depend on when timer0 happens to fire.
+#
+# timer0_isr is timed on every call for the whole run, so its max is the
+# worst case over all the button edges, events and loop ticks of the
+# scenarios; the other routines are sampled.
+#
+# make bench-baseline also writes the worst case of each metric with a
+# budget ("worst"); that of timer0_isr is quoted next to CLK_SLOW_DIV in
+# main.c.
+#
+# "wake" is the wake-up latency: cycles from pressing SW1 in power down to
+# the first digit lit with something on it (P1 not all 0xFF). The digits
+# lit from the blank display buffer before main() has read the clock and
+# drawn the time don't count.
+#
+
+import argparse
+import json
+import os
+import sys
+
+from sim51 import Sim51, read_map, CLOCKS_PER_CYCLE, SW1, SW2
+
+BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'bench_baseline.json')
+
+# routines timed per call; "loop" is one pass of main() between two calls of
+# the loop pacing routine (loop_marker in the baseline file)
+ROUTINES = ['_timer0_isr', '_ds_readburst', '_sendbyte', '_readbyte']
+ISRS = ['_timer0_isr', '_INT1_routine']
+
+# calls sampled per routine and scenario before its breakpoint is dropped;
+# the routines in ALWAYS are timed on every call
+SAMPLES = 32
+ALWAYS = ['_timer0_isr']
+
+# scenario steps: ('run', ms) / ('pin', sw, level) / ('sleep', max_ms) /
+# ('wake', max_ms): press SW1 and time the first frame
+SCENARIOS = {
+    'idle': [
+        ('run', 2000),
+    ],
+    'browse': [
+        ('run', 500),
+        ('pin', SW1, 0), ('run', 300), ('pin', SW1, 1), ('run', 700),   # date
+        ('pin', SW1, 0), ('run', 300), ('pin', SW1, 1), ('run', 700),   # year
+        ('pin', SW1, 0), ('run', 300), ('pin', SW1, 1), ('run', 700),   # weekday
+    ],
+    'set_hour': [
+        ('run', 500),
+        ('pin', SW1, 0), ('run', 1800), ('pin', SW1, 1), ('run', 300),  # K_SET_HOUR
+        ('pin', SW2, 0), ('run', 3000), ('pin', SW2, 1), ('run', 300),  # hold to repeat
+    ],
+    'message': [
+        ('run', 500),
+        ('pin', SW1, 0), ('pin', SW2, 0), ('run', 1800),
+        ('pin', SW1, 1), ('pin', SW2, 1), ('run', 6000),
+    ],
+    # timer0_isr's longest path: a digit switch, and both buttons posting
+    # an event in the same check pass (SW1 released short, SW2 pressed)
+    'isr_worst': [
+        ('run', 500),
+        ('pin', SW1, 0), ('run', 300),
+        ('pin', SW1, 1), ('pin', SW2, 0), ('run', 300),
+        ('pin', SW2, 1), ('run', 300),
+    ],
+    'sleep_wake': [
+        ('sleep', 8000),
+        ('wake', 50), ('run', 200), ('pin', SW1, 1), ('run', 800),
+    ],
+}
+
+
+class Bench:
+
+    def __init__(self, sim, syms, loop_marker):
+        self.sim = sim
+        self.syms = syms
+        self.entry = {syms[r]: r for r in ROUTINES if r in syms}
+        self.marker = syms.get(loop_marker)
+        if self.marker is None:
+            sys.exit('bench: loop marker %s not found in map file' % loop_marker)
+        self.pending = []   # (return address, sp, routine, clocks, isr clocks)
+        self.samples = {r: [] for r in ROUTINES + ['loop', 'wake', '_marker']}
+        self.loop_start = None
+        for addr in self.entry:
+            sim.set_break(addr)
+        sim.set_break(self.marker)
+
+    def step(self):
+        """Run to the next breakpoint and account for it; returns the pc."""
+        pc = self.sim.run()
+        clk, isr, _, _ = self.sim.state()
+
+        # returning from a timed routine
+        for i, (ret, sp, name, t0, i0) in enumerate(self.pending):
+            if ret == pc and self.sim.sfr(0x81) == sp - 2:
+                del self.pending[i]
+                spent = clk - t0 if name in ISRS else (clk - t0) - (isr - i0)
+                self.samples[name].append(spent)
+                if name == '_marker':
+                    self.loop_start = (clk, isr)
+                return pc
+
+        if pc == self.marker:
+            if self.loop_start is not None:
+                c0, i0 = self.loop_start
+                self.samples['loop'].append((clk - c0) - (isr - i0))
+            self._track(pc, '_marker', clk, isr)
+
+        if pc in self.entry:
+            name = self.entry[pc]
+            self._track(pc, name, clk, isr)
+            if name not in ALWAYS and len(self.samples[name]) + 1 >= SAMPLES:
+                self.sim.clear_break(pc)
+                del self.entry[pc]
+        return pc
+
+    def _track(self, pc, name, clk, isr):
+        ret, sp = self.sim.return_address()
+        self.pending.append((ret, sp, name, clk, isr))
+        self.sim.set_break(ret, temp=True)
+
+    def advance(self, ms):
+        end = self.sim.clocks() + int(ms * self.clk_per_ms)
+        while self.sim.clocks() < end:
+            self.step()
+
+    def sleep(self, max_ms):
+        """Run until the firmware enters power down (PCON.PD)."""
+        end = self.sim.clocks() + int(max_ms * self.clk_per_ms)
+        nr = self.sim.break_write('sfr', 0x87)
+        try:
+            while not self.sim.sfr(0x87) & 0x02:
+                if self.sim.clocks() > end:
+                    sys.exit('bench: firmware did not power down within %d ms' % max_ms)
+                self.step()
+        finally:
+            self.sim.delete_break(nr)
+
+    def wake(self, max_ms):
+        """Press SW1 in power down and time it until the first frame shows."""
+        self.sim.pin(SW1, 0)
+        start = self.sim.clocks()
+        end = start + int(max_ms * self.clk_per_ms)
+        nr = self.sim.break_write('sfr', 0xB0)
+        try:
+            while not (self.sim.sfr(0xB0) & 0xF0 and self.sim.sfr(0x90) != 0xFF):
+                if self.sim.clocks() > end:
+                    sys.exit('bench: nothing shown within %d ms of waking up' % max_ms)
+                self.step()
+        finally:
+            self.sim.delete_break(nr)
+        self.samples['wake'].append(self.sim.clocks() - start)
+
+    def results(self):
+        out = {}
+        for name, s in self.samples.items():
+            if s and name != '_marker':
+                s = [c // CLOCKS_PER_CYCLE for c in s]
+                out[name.lstrip('_')] = {'avg': sum(s) // len(s), 'max': max(s), 'n': len(s)}
+        return out
+
+
+def run_scenario(args, syms, steps, loop_marker):
+    sim = Sim51(args.hexfile, s51=args.s51, xtal=args.xtal)
+    try:
+        bench = Bench(sim, syms, loop_marker)
+        bench.clk_per_ms = args.clk_per_ms
+        for step in steps:
+            if step[0] == 'run':
+                bench.advance(step[1])
+            elif step[0] == 'pin':
+                sim.pin(step[1], step[2])
+            elif step[0] == 'sleep':
+                bench.sleep(step[1])
+            elif step[0] == 'wake':
+                bench.wake(step[1])
+        return bench.results()
+    finally:
+        sim.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description='cycle benchmark for the -DSIM51 firmware under ucsim/s51')
+    ap.add_argument('hexfile')
+    ap.add_argument('--map', default='build/sim/main.map')
+    ap.add_argument('--s51', default='s51')
+    ap.add_argument('--sysclk', type=int, default=11059, help='STC15 clock the firmware was built for, kHz')
+    ap.add_argument('--baseline', default=BASELINE)
+    ap.add_argument('--update', action='store_true', help='write results as the new baseline')
+    ap.add_argument('--only', action='append', help='run only the named scenario(s)')
+    args = ap.parse_args()
+
+    # one machine cycle per STC15 clock; ucsim reports oscillator clocks
+    args.clk_per_ms = args.sysclk * CLOCKS_PER_CYCLE
+    args.xtal = '%dk' % args.clk_per_ms
+
+    with open(args.baseline) as f:
+        base = json.load(f)
+    # the baseline file ships without scenarios until one is recorded from
+    # a real s51 run; say so rather than fail every scenario
+    if not base['scenarios'] and not args.update:
+        sys.exit('bench: no baseline recorded in %s yet, so there is nothing to compare '
+                 'against; run "make bench-baseline" with s51 to record one' % args.baseline)
+    syms = read_map(args.map)
+    tolerance = base.get('tolerance', 0.02)
+
+    results = {}
+    failed = False
+    for name, steps in SCENARIOS.items():
+        if args.only and name not in args.only:
+            continue
+        results[name] = run_scenario(args, syms, steps, base['loop_marker'])
+        print('%s' % name)
+        for metric, r in sorted(results[name].items()):
+            ref = base['scenarios'].get(name, {}).get(metric)
+            line = '  %-14s avg %8d  max %8d  (n=%d)' % (metric, r['avg'], r['max'], r['n'])
+            if ref is not None:
+                delta = (r['avg'] - ref['avg']) / float(ref['avg']) if ref['avg'] else 0
+                line += '  %+6.1f%%' % (delta * 100)
+                if delta > tolerance:
+                    line += '  REGRESSION'
+                    failed = True
+            elif not args.update:
+                line += '  NO BASELINE'
+                failed = True
+            budget = base.get('budgets', {}).get(metric)
+            if budget is not None and r['max'] > budget:
+                print('  %-14s max %8d  over budget of %d' % (metric, r['max'], budget))
+                failed = True
+            print(line)
+
+    if args.update:
+        base['scenarios'].update(results)
+        # the measured worst case of the metrics with a budget, over all
+        # recorded scenarios; main.c quotes the one of timer0_isr
+        base['worst'] = {m: max(r[m]['max'] for r in base['scenarios'].values() if m in r)
+                         for m in base.get('budgets', {})
+                         if any(m in r for r in base['scenarios'].values())}
+        with open(args.baseline, 'w') as f:
+            json.dump(base, f, indent=2, sort_keys=True)
+            f.write('\n')
+        print('baseline written to %s' % args.baseline)
+    elif failed:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
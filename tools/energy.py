@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#
+# Energy and battery-life estimate for the watch firmware (make energy).
+#
+# Replays one display-on session of the simulator build (-DSIM51, see
+# sim51.py) under ucsim/s51 and traces every write to P0, P1, P3, PCON and
+# CLK_DIV. From the trace it integrates
+#
+#   - CPU time spent active, in IDLE (PCON.IDL) and in power down (PCON.PD),
+#     and at which clock divider (CLK_DIV)
+#   - how long each segment of each LED digit is lit (the P3 anode nibble
+#     and the P1 segment byte written by timer0_isr)
+#   - how long the DS1302 is selected (DS_CE high)
+#   - the DS1302 pin states left behind when the MCU powers down
+#
+# Each state is weighted by a current coefficient, giving the average
+# current with the display on and off. Combined with a usage profile this
+# projects the life of a CR2032.
+#
+# The default coefficients are UNCALIBRATED estimates. They were picked so
+# that the display-off current of the stock board adds up to the README's
+# 300uA (pd_base plus three floating DS1302 pins), but the tool has never
+# been run against a real -DSIM51 image. Nobody has checked that a traced
+# session reproduces the README's 8mA with the display on, or the 2mA
+# saved by dividing the clock. Until someone does, treat the results as
+# a way to compare builds, not as currents. Every report says so unless
+# --calibrate or --coeffs is given. The CPU currents are for the
+# undivided clock and are scaled down with CLK_DIV, as the STC15 core
+# draws current in proportion to its clock. Fit the per-segment LED
+# current after measuring a watch with --calibrate <measured display-on mA>.
+#
+
+import argparse
+import json
+import sys
+
+from sim51 import Sim51, read_map, CLOCKS_PER_CYCLE, SW1
+
+# current coefficients, mA
+COEFFS = {
+    'cpu_active': 2.7,      # CPU running at 11.0592MHz, CLK_DIV = 0
+    'cpu_idle': 0.9,        # PCON.IDL; timers and interrupts still running, CLK_DIV = 0
+    'segment': 2.4,         # one lit segment while its digit is enabled
+    'ds_active': 0.3,       # DS1302 with CE high (transfer in progress)
+    'pd_base': 0.05,        # MCU power down plus DS1302 timekeeping
+    'pullup_low': 0.3,      # stock board: DS pin driven low against its 10k pull-up
+    'pullup_float': 0.083,  # stock board: 10k pull-up into the DS1302 40k pull-down
+    'pushpull_high': 0.075, # modded board: pin driven high into the 40k pull-down
+}
+
+# DS1302 pins (port, bit): DS_CE, DS_IO, DS_SCLK
+DS_PINS = [(0, 0), (0, 1), (3, 2)]
+
+SFR = {'P0': 0x80, 'P1': 0x90, 'P3': 0xB0, 'PCON': 0x87, 'CLK_DIV': 0x97}
+MODE = {0: (0x94, 0x93), 3: (0xB2, 0xB1)}   # port -> (PxM0, PxM1)
+IE = 0xA8
+
+
+class Tracer:
+
+    def __init__(self, sim, marker, clk_per_ms):
+        self.sim = sim
+        self.marker = marker
+        self.clk_per_ms = clk_per_ms
+        sim.set_break(marker)
+
+    def run_for(self, ms):
+        end = self.sim.clocks() + int(ms * self.clk_per_ms)
+        while self.sim.clocks() < end:
+            self.sim.run()
+
+    def run_until_sleep(self):
+        """Run until EX1 is enabled, i.e. main() is about to power down."""
+        start = self.sim.clocks()
+        nr = self.sim.break_write('sfr', IE)
+        try:
+            while not self.sim.sfr(IE) & 0x04:
+                self.sim.run()
+        finally:
+            self.sim.delete_break(nr)
+        return self.sim.clocks() - start
+
+    def trace(self, ms):
+        """Trace port and PCON writes for ms milliseconds; returns state times."""
+        nrs = [self.sim.break_write('sfr', a) for a in SFR.values()]
+        # active and idle time are also kept scaled to the undivided clock;
+        # digit[d] is the time digit d is enabled, lit[d][s] the time its
+        # segment s (P1.s) is lit
+        t = {'total': 0, 'idle': 0, 'active_full': 0, 'idle_full': 0,
+             'segment': 0, 'ds_active': 0, 'div': {},
+             'digit': [0] * 4, 'lit': [[0] * 8 for _ in range(4)]}
+        clk, _, idle, _ = self.sim.state()
+        ports = {k: self.sim.sfr(a) for k, a in SFR.items()}
+        end = clk + int(ms * self.clk_per_ms)
+        try:
+            while clk < end:
+                self.sim.run()
+                now, _, now_idle, _ = self.sim.state()
+                dt = now - clk
+                t['total'] += dt
+                t['idle'] += now_idle - idle
+                # the simulator ignores CLK_DIV. on the watch the active part
+                # takes 2^div times as long at 1/2^div of the current, which
+                # leaves that much less time idle
+                div = ports['CLK_DIV'] & 7
+                t['div'][div] = t['div'].get(div, 0) + dt
+                active = dt - (now_idle - idle)
+                t['active_full'] += active
+                t['idle_full'] += max(0, now_idle - idle - active * ((1 << div) - 1)) / float(1 << div)
+                # segments are active low on P1, digits active high on P3.4-7
+                for d in range(4):
+                    if ports['P3'] >> (4 + d) & 1:
+                        t['digit'][d] += dt
+                        for seg in range(8):
+                            if not ports['P1'] >> seg & 1:
+                                t['lit'][d][seg] += dt
+                                t['segment'] += dt
+                if ports['P0'] & 0x01:
+                    t['ds_active'] += dt
+                clk, idle = now, now_idle
+                ports = {k: self.sim.sfr(a) for k, a in SFR.items()}
+        finally:
+            for nr in nrs:
+                self.sim.delete_break(nr)
+        return t
+
+    def sleep_pins(self):
+        """Classify the DS1302 pins as the MCU powers down; returns the pin
+        states and the board variant the build was made for: the DS_PUSHPULL
+        build leaves the pins push-pull, the stock one never does."""
+        pins, pushpull = [], 0
+        for port, bit in DS_PINS:
+            m0, m1 = (self.sim.sfr(a) >> bit & 1 for a in MODE[port])
+            level = self.sim.sfr(SFR['P%d' % port]) >> bit & 1
+            pushpull += m0 and not m1
+            if m1 and not m0:
+                pins.append('float')
+            elif level:
+                pins.append('high')
+            else:
+                pins.append('low')
+        if pushpull not in (0, len(DS_PINS)):
+            sys.exit('energy: DS1302 pins are partly push-pull in power down (%s)' % ', '.join(pins))
+        return pins, 'pushpull' if pushpull else 'stock'
+
+
+def on_current(t, c):
+    return (t['active_full'] * c['cpu_active'] + t['idle_full'] * c['cpu_idle']
+            + t['segment'] * c['segment'] + t['ds_active'] * c['ds_active']) / t['total']
+
+
+def print_lit(t):
+    """Per digit and per segment lit time, in % of the traced time."""
+    pct = lambda clk: 100.0 * clk / t['total']
+    print('lit, %% of %.0f ms:  ' % (t['total'] / t['clk_per_ms'])
+          + ' '.join('P1.%d' % seg for seg in range(8)) + '  digit')
+    for d in range(4):
+        print('  digit %d          ' % d
+              + ' '.join('%4.1f' % pct(c) for c in t['lit'][d])
+              + '  %5.1f' % pct(t['digit'][d]))
+
+
+def off_current(pins, c, board):
+    i = c['pd_base']
+    for p in pins:
+        if board == 'stock':
+            i += c['pullup_low'] if p == 'low' else c['pullup_float']
+        elif p == 'high':
+            i += c['pushpull_high']
+    return i
+
+
+def main():
+    ap = argparse.ArgumentParser(description='energy and battery-life estimate for the -DSIM51 firmware')
+    ap.add_argument('hexfile')
+    ap.add_argument('--map', default='build/sim/main.map')
+    ap.add_argument('--s51', default='s51')
+    ap.add_argument('--sysclk', type=int, default=11059, help='STC15 clock the firmware was built for, kHz')
+    ap.add_argument('--marker', default='_loop_wait', help='symbol called once per main loop')
+    ap.add_argument('--coeffs', help='JSON file overriding current coefficients (mA)')
+    ap.add_argument('--board', choices=['stock', 'pushpull'],
+                    help='pushpull = the three DS1302 10k pull-ups removed; '
+                         'by default taken from the pin modes the traced build powers down with')
+    ap.add_argument('--wakes-per-day', type=float, default=40)
+    ap.add_argument('--capacity', type=float, default=200, help='battery capacity, mAh')
+    ap.add_argument('--window', type=float, default=1000, help='traced display-on time, ms')
+    ap.add_argument('--calibrate', type=float, metavar='MA',
+                    help='fit the segment coefficient to a measured display-on current')
+    args = ap.parse_args()
+
+    c = dict(COEFFS)
+    if args.coeffs:
+        with open(args.coeffs) as f:
+            c.update(json.load(f))
+    # one machine cycle per STC15 clock, as for make bench
+    clk_per_ms = args.sysclk * CLOCKS_PER_CYCLE
+    syms = read_map(args.map)
+    if args.marker not in syms:
+        sys.exit('energy: %s not found in map file' % args.marker)
+
+    sim = Sim51(args.hexfile, s51=args.s51, xtal='%dk' % clk_per_ms)
+    try:
+        tr = Tracer(sim, syms[args.marker], clk_per_ms)
+
+        # let the boot session expire, then measure one button-initiated session
+        tr.run_until_sleep()
+        sim.pin(SW1, 0)
+        tr.run_for(200)
+        sim.pin(SW1, 1)
+        t = tr.trace(args.window)
+        session = 200 * clk_per_ms + t['total'] + tr.run_until_sleep()
+        pins, board = tr.sleep_pins()
+    finally:
+        sim.close()
+    t['clk_per_ms'] = clk_per_ms
+    if args.board and args.board != board:
+        sys.exit('energy: --board %s, but the image was built for the %s board%s'
+                 % (args.board, board, ' (BOARDOPTS=-DDS_PUSHPULL)' if board == 'pushpull' else ''))
+
+    if args.calibrate:
+        if not t['segment']:
+            sys.exit('energy: no segment was lit in the traced window')
+        rest = on_current(t, dict(c, segment=0))
+        c['segment'] = (args.calibrate - rest) * t['total'] / t['segment']
+        print('segment coefficient: %.3f mA' % c['segment'])
+
+    i_on = on_current(t, c)
+    i_off = off_current(pins, c, board)
+    on_s = session / clk_per_ms / 1000
+    day_on = min(86400, args.wakes_per_day * on_s)
+    avg = (day_on * i_on + (86400 - day_on) * i_off) / 86400
+
+    print('display on:  %6.2f mA  (%.1f%% idle, %.1f s per wake)'
+          % (i_on, 100.0 * t['idle'] / t['total'], on_s))
+    print('             %s' % ', '.join('%.1f%% at CLK_DIV %d' % (100.0 * dt / t['total'], div)
+                                       for div, dt in sorted(t['div'].items())))
+    print('display off: %6.3f mA  (%s board, DS1302 pins: %s)' % (i_off, board, ', '.join(pins)))
+    print('average:     %6.3f mA  at %g wakes/day' % (avg, args.wakes_per_day))
+    print('CR2032 life: %6.0f days (%g mAh)' % (args.capacity / avg / 24, args.capacity))
+    print_lit(t)
+    if not args.calibrate and not args.coeffs:
+        print('NOTE: uncalibrated coefficients; use the figures to compare builds, not as currents')
+
+
+if __name__ == '__main__':
+    main()
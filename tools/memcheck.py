@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+#
+# Memory report for the linked firmware (make size).
+#
+# Reads the sdcc memory map (build/main.mem) and prints how much of the
+# program flash and of the IRAM stack is left. sdcc stops at the link when
+# code or variables don't fit, but nothing checks the stack that is left
+# above the variables, so the run fails when that is below --stack-min.
+#
+# Given the .asm files sdcc wrote for the build (--asm), it also works out
+# the stack the code needs: the deepest chain of calls from main(), each
+# call's return address and the pushes along the way, plus the largest
+# interrupt frame on top of it. The run fails when that doesn't fit
+# either. The count follows the code sdcc generated, so the caller saved
+# registers and the callee_saves pushes are in it. Library routines
+# (__divuint etc.) are not in the .asm files and are counted as
+# --lib-stack bytes each.
+#
+
+import argparse
+import re
+import sys
+
+STACK = re.compile(r'Stack starts at:\s*0x([0-9a-fA-F]+).*?with\s+(\d+)\s+bytes? available')
+ROM = re.compile(r'ROM/EPROM/FLASH\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\d+)\s+(\d+)')
+
+# sdcc .asm
+FUNC = re.compile(r';\s+function\s+(\w+)\s*$')
+LABEL = re.compile(r'^\s*(\w+\$?):')
+INSN = re.compile(r'^\s+([a-z]+)\b\s*(.*?)\s*(;.*)?$')
+CALLS = ('lcall', 'acall')
+JUMPS = ('ljmp', 'sjmp', 'ajmp')
+BRANCHES = ('jz', 'jnz', 'jc', 'jnc', 'jb', 'jnb', 'jbc', 'cjne', 'djnz')
+ENDS = ('ret', 'reti', 'ljmp', 'sjmp', 'ajmp', 'jmp')
+ADDR_REF = re.compile(r'\b_(\w+)\b')
+CALL_DPTR = '__sdcc_call_dptr'
+
+
+class Func:
+
+    def __init__(self, name):
+        self.name = name
+        self.depth = 0      # most bytes pushed by the function itself
+        self.calls = []     # (bytes pushed at the call, target, tail call)
+        self.isr = False
+
+
+def parse_asm(paths, startup):
+    """Return ({name: Func}, names whose address is taken); startup[0] is
+    set to the bytes the startup code's call of main() takes."""
+    funcs, refs = {}, set()
+    for path in paths:
+        with open(path) as f:
+            lines = f.read().splitlines()
+        area, pending, fn = None, None, None
+        cur, at_label, ended = 0, {}, False
+        for line in lines:
+            m = re.match(r'\s*\.area\s+(\w+)', line)
+            if m:
+                area = m.group(1)
+                fn = None
+                continue
+            m = FUNC.match(line)
+            if m:
+                pending = m.group(1)
+                continue
+            # function addresses in the const tables (function pointers)
+            if re.match(r'\s+\.(byte|dw)\b', line):
+                refs.update(ADDR_REF.findall(line))
+                continue
+            m = LABEL.match(line)
+            if m:
+                label = m.group(1)
+                if pending and label == '_' + pending and area == 'CSEG':
+                    fn = funcs[pending] = Func(pending)
+                    pending, cur, at_label, ended = None, 0, {}, False
+                elif fn:
+                    # reached by a jump, or by falling through as well. a
+                    # label no jump was seen to (a switch's jump table)
+                    # keeps the depth of the code before it
+                    cur = at_label.get(label, cur) if ended else max(cur, at_label.get(label, cur))
+                    ended = False
+                continue
+            m = INSN.match(line)
+            if not m:
+                continue
+            op, args = m.group(1), m.group(2)
+            target = args.split(',')[-1].strip()
+            if not fn:
+                # sdcc's startup code jumps to main(); count a call
+                if op in CALLS and target == '_main':
+                    startup[0] = 2
+                continue
+            name = target[1:] if target.startswith('_') else target
+            if op == 'push':
+                cur += 1
+                fn.depth = max(fn.depth, cur)
+            elif op == 'pop':
+                cur -= 1
+            elif op in CALLS:
+                fn.calls.append((cur, name if target != CALL_DPTR else None, False))
+            elif op in JUMPS and target.startswith('_') and not target.endswith('$'):
+                fn.calls.append((cur, name, True))
+            elif op in JUMPS + BRANCHES:
+                at_label[target] = max(at_label.get(target, cur), cur)
+            elif op == 'reti':
+                fn.isr = True
+            elif op == 'mov' and '#_' in args:
+                refs.update(ADDR_REF.findall(args.split('#', 1)[1]))
+            if op in ENDS:
+                ended = True
+    return funcs, refs & set(funcs)
+
+
+def stack_of(name, funcs, targets, lib, seen, assumed):
+    """Bytes a call to name needs below its return address; (bytes, chain)."""
+    fn = funcs.get(name)
+    if fn is None:
+        assumed.add(name)
+        return lib, [name + '?']
+    if name in seen:
+        sys.exit('memcheck: %s is recursive' % name)
+    best, chain = fn.depth, []
+    for cur, target, tail in fn.calls:
+        if target is None:
+            # __sdcc_call_dptr pushes the target address and rets to it
+            n, c = 2, ['(call_dptr)']
+            for t in targets:
+                tn, tc = stack_of(t, funcs, targets, lib, seen | {name}, assumed)
+                if tn > n:
+                    n, c = tn, ['(call_dptr)'] + tc
+            n += 2
+        else:
+            n, c = stack_of(target, funcs, targets, lib, seen | {name}, assumed)
+            if not tail:
+                n += 2
+        if cur + n > best:
+            best, chain = cur + n, c
+    return best, [name] + chain
+
+
+def asm_stack(paths, lib):
+    """Return (bytes needed, deepest chain, interrupt, library routines assumed)."""
+    startup = [0]
+    funcs, targets = parse_asm(paths, startup)
+    if 'main' not in funcs:
+        sys.exit('memcheck: no main() in the .asm files')
+    assumed = set()
+    need, chain = stack_of('main', funcs, targets, lib, set(), assumed)
+    need += startup[0]
+    isr, isr_name = 0, None
+    for fn in funcs.values():
+        if fn.isr:
+            n = 2 + stack_of(fn.name, funcs, targets, lib, set(), assumed)[0]
+            if n > isr:
+                isr, isr_name = n, fn.name
+    return need + isr, chain, (isr_name, isr), sorted(assumed)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='code and stack report from an sdcc .mem file')
+    ap.add_argument('memfile')
+    ap.add_argument('--stack-min', type=int, default=32, help='bytes of stack needed')
+    ap.add_argument('--asm', nargs='*', default=[], help='sdcc .asm files of the build; works out the stack needed')
+    ap.add_argument('--lib-stack', type=int, default=4, help='bytes of stack counted for each library routine')
+    args = ap.parse_args()
+
+    with open(args.memfile) as f:
+        mem = f.read()
+    stack = STACK.search(mem)
+    rom = ROM.search(mem)
+    if not stack or not rom:
+        sys.exit('memcheck: %s is not an sdcc memory map' % args.memfile)
+
+    size, limit = int(rom.group(3)), int(rom.group(4))
+    free = int(stack.group(2))
+    need = args.stack_min
+    print('code:  %5d of %d bytes (%d free)' % (size, limit, limit - size))
+    if args.asm:
+        deepest, chain, (isr_name, isr), assumed = asm_stack(args.asm, args.lib_stack)
+        print('calls: %5d bytes: %s, + %s (%d)' % (deepest, ' > '.join(chain), isr_name, isr))
+        if assumed:
+            print('       %d bytes counted for each of %s' % (args.lib_stack, ', '.join(assumed)))
+        need = max(need, deepest)
+    print('stack: %5d bytes from 0x%02X (%d needed)' % (free, int(stack.group(1), 16), need))
+
+    failed = False
+    if size > limit:
+        print('memcheck: code is %d bytes over' % (size - limit))
+        failed = True
+    if free < need:
+        print('memcheck: stack is %d bytes short' % (need - free))
+        failed = True
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+#
+# Data flash image for stc-isp (make eeprom).
+#
+# Reads the Intel HEX firmware (main.hex) and writes the bytes of the data
+# flash region (0x1000-0x13FF) to a HEX file of their own, moved down to
+# address 0 as stc-isp loads them. Records are written again with their
+# new addresses and checksums, 16 bytes each.
+#
+
+import argparse
+import sys
+
+START, END = 0x1000, 0x1400
+RECLEN = 16
+
+
+def read_hex(path):
+    """Return {address: byte} of the data records."""
+    data = {}
+    with open(path) as f:
+        for nr, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            if not line.startswith(':'):
+                sys.exit('%s:%d: not an Intel HEX record' % (path, nr))
+            rec = bytes.fromhex(line[1:])
+            if len(rec) < 5 or len(rec) != rec[0] + 5 or sum(rec) & 0xFF:
+                sys.exit('%s:%d: bad record or checksum' % (path, nr))
+            kind, addr = rec[3], rec[1] << 8 | rec[2]
+            if kind == 0x00:
+                for i, b in enumerate(rec[4:-1]):
+                    data[addr + i] = b
+            elif kind == 0x01:
+                break
+            else:
+                sys.exit('%s:%d: record type %02X not supported' % (path, nr, kind))
+    return data
+
+
+def record(addr, kind, payload):
+    rec = bytes([len(payload), addr >> 8, addr & 0xFF, kind]) + bytes(payload)
+    return ':%s%02X' % (rec.hex().upper(), -sum(rec) & 0xFF)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='data flash region of a HEX file, moved to address 0')
+    ap.add_argument('hexfile')
+    ap.add_argument('output')
+    args = ap.parse_args()
+
+    data = read_hex(args.hexfile)
+    lines = []
+    addr = START
+    while addr < END:
+        if addr not in data:
+            addr += 1
+            continue
+        run = []
+        while addr + len(run) < END and addr + len(run) in data and len(run) < RECLEN:
+            run.append(data[addr + len(run)])
+        lines.append(record(addr - START, 0x00, run))
+        addr += len(run)
+    if not lines:
+        sys.exit('mkeeprom: %s has nothing at 0x%04X-0x%04X' % (args.hexfile, START, END - 1))
+    lines.append(record(0, 0x01, []))
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
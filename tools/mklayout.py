@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+#
+# IRAM layout compiler for the watch firmware (make layout).
+#
+# Reads src/layout.txt and writes src/layout.h: the __at placement of each
+# table, a __bit __at alias for each named bit (HAL_BIT() reads in the
+# host build) with BYTE/MASK macros for changing it in either build, and
+# BYTE/MASK/SHIFT macros for each bit field. The tables are
+# packed into the bit addressable bytes after the ones left to sdcc's own
+# __bit variables, and the build stops here if anything overlaps:
+#
+#   - tables past --data-loc, or past the bit addressable bytes
+#   - bits and fields outside their table, or sharing a bit
+#   - more __bit variables in the given sources than 'bits' leaves room for
+#
+# layout.h repeats the --data-loc check against DATA_LOC, so changing
+# DATALOC in the Makefile without running this again fails too. With
+# --check nothing is written; the run fails if the header differs from
+# what would be generated, e.g. after a __bit variable was added or
+# removed without running make layout.
+#
+
+import argparse
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+BIT_BASE = 0x20     # first bit addressable byte; bit address 0x00
+BIT_END = 0x30
+
+TABLE = re.compile(r'table\s+(\w+)\s*\[\s*(\d+)\s*\]$')
+BIT = re.compile(r'bit\s+(\w+)\s*=\s*(\w+)\s*\[\s*(\d+)\s*\]\s*\.\s*([0-7])$')
+FIELD = re.compile(r'field\s+(\w+)\s*=\s*(\w+)\s*\[\s*(\d+)\s*\]\s*\.\s*([0-7])\s*-\s*([0-7])$')
+BITS = re.compile(r'bits\s+(\d+)$')
+
+# __bit variables sdcc allocates itself (not __at, not parameters or casts)
+BITVAR = re.compile(r'\b__bit\s+(?!__at\b)([A-Za-z_][\w\s,=]*);')
+
+
+def fail(path, nr, msg):
+    sys.exit('%s:%d: %s' % (path, nr, msg))
+
+
+def parse(path):
+    """Return (bits, [(name, size, nr)], [(kind, name, table, index, mask, shift, nr)])."""
+    bits, tables, members = None, [], []
+    with open(path) as f:
+        for nr, line in enumerate(f, 1):
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            m = BITS.match(line)
+            if m:
+                bits = int(m.group(1))
+                continue
+            m = TABLE.match(line)
+            if m:
+                tables.append((m.group(1), int(m.group(2)), nr))
+                continue
+            m = BIT.match(line)
+            if m:
+                b = int(m.group(4))
+                members.append(('bit', m.group(1), m.group(2), int(m.group(3)), 1 << b, b, nr))
+                continue
+            m = FIELD.match(line)
+            if m:
+                hi, lo = int(m.group(4)), int(m.group(5))
+                if hi < lo:
+                    fail(path, nr, 'field bits go high-low')
+                mask = (0xFF >> (7 - hi)) & (0xFF << lo) & 0xFF
+                members.append(('field', m.group(1), m.group(2), int(m.group(3)), mask, lo, nr))
+                continue
+            fail(path, nr, 'expected bits, table, bit or field')
+    if bits is None:
+        sys.exit('%s: no bits line' % path)
+    return bits, tables, members
+
+
+def count_bits(sources):
+    n = 0
+    for src in sources:
+        with open(src) as f:
+            text = re.sub(r'//.*', '', f.read())
+        for m in BITVAR.finditer(text):
+            if not re.search(r'\bextern\s+(volatile\s+)?$', text[:m.start()].rsplit('\n', 1)[-1]):
+                n += len(m.group(1).split(','))
+    return n
+
+
+def main():
+    ap = argparse.ArgumentParser(description='compile the IRAM layout into src/layout.h')
+    ap.add_argument('input', nargs='?', default=os.path.join(HERE, '..', 'src', 'layout.txt'))
+    ap.add_argument('output', nargs='?', default=os.path.join(HERE, '..', 'src', 'layout.h'))
+    ap.add_argument('--data-loc', type=lambda v: int(v, 0), default=0x30,
+                    help='sdcc --data-loc (default 0x30)')
+    ap.add_argument('--sources', nargs='*', default=[],
+                    help='sources whose __bit variables must fit in the bits bytes')
+    ap.add_argument('--check', action='store_true',
+                    help='fail if output differs from the generated header instead of writing it')
+    args = ap.parse_args()
+
+    bits, tables, members = parse(args.input)
+
+    used = count_bits(args.sources)
+    if used > bits * 8:
+        sys.exit('%s: %d __bit variables in the sources, room for %d (bits %d)'
+                 % (args.input, used, bits * 8, bits))
+
+    # tables in file order, from the end of the bits bytes
+    addr, placed, end = BIT_BASE + bits, {}, min(BIT_END, args.data_loc)
+    for name, size, nr in tables:
+        if name in placed:
+            fail(args.input, nr, 'table %s defined twice' % name)
+        placed[name] = (addr, size)
+        addr += size
+        if addr > end:
+            fail(args.input, nr, 'table %s ends at %#04x, past %s %#04x'
+                 % (name, addr, '--data-loc' if end == args.data_loc else 'the bit addressable bytes', end))
+
+    names, taken = set(), {}
+    for kind, name, table, index, mask, shift, nr in members:
+        if name in names:
+            fail(args.input, nr, '%s defined twice' % name)
+        names.add(name)
+        if table not in placed:
+            fail(args.input, nr, 'no table %s' % table)
+        if index >= placed[table][1]:
+            fail(args.input, nr, '%s[%d] is past the end of the table' % (table, index))
+        other = taken.get((table, index), {})
+        for b in range(8):
+            if mask & 1 << b and b in other:
+                fail(args.input, nr, '%s shares %s[%d] bit %d with %s' % (name, table, index, b, other[b]))
+        for b in range(8):
+            if mask & 1 << b:
+                other[b] = name
+        taken[(table, index)] = other
+
+    out = ['// generated by tools/mklayout.py from %s; do not edit' % os.path.basename(args.input),
+           '//', '// see tools/mklayout.py for the format', '',
+           '// bytes 0x20-%#04x are left to sdcc for %d __bit variables (%d in use)'
+           % (BIT_BASE + bits - 1, bits * 8, used),
+           '#define LAYOUT_END  %#04x' % addr, '',
+           '#if defined(DATA_LOC) && DATA_LOC < LAYOUT_END',
+           '#error "the tables of layout.txt run past --data-loc"',
+           '#endif', '']
+    for name, size, nr in tables:
+        out.append('uint8_t __at (%#04x) %s[%d];' % (placed[name][0], name, size))
+
+    bitdefs = [(n, t, i, s) for k, n, t, i, m, s, nr in members if k == 'bit']
+    if bitdefs:
+        out += ['', '#ifdef __SDCC']
+        for n, t, i, s in bitdefs:
+            out.append('__bit __at (%#04x) %s;\t// %s[%d].%d'
+                       % ((placed[t][0] + i - BIT_BASE) * 8 + s, n, t, i, s))
+        out += ['#else', '// host build: read-only; change the tables with the masks instead']
+        for n, t, i, s in bitdefs:
+            out.append('#define %-14s HAL_BIT(%s[%d], %d)' % (n, t, i, s))
+        out.append('#endif')
+        out.append('')
+        for n, t, i, s in bitdefs:
+            out += ['#define %-24s %d\t// %s[%d]' % (n + '_BYTE', i, t, i),
+                    '#define %-24s 0b%s' % (n + '_MASK', format(1 << s, '08b'))]
+
+    fields = [(n, t, i, m, s) for k, n, t, i, m, s, nr in members if k == 'field']
+    if fields:
+        out.append('')
+    for name, table, index, mask, shift in fields:
+        out += ['#define %-24s %d\t// %s[%d]' % (name + '_BYTE', index, table, index),
+                '#define %-24s 0b%s' % (name + '_MASK', format(mask, '08b')),
+                '#define %-24s %d' % (name + '_SHIFT', shift)]
+
+    text = '\n'.join(out) + '\n'
+    if args.check:
+        try:
+            with open(args.output) as f:
+                current = f.read()
+        except OSError:
+            current = None
+        if current != text:
+            sys.exit('%s is out of date; run make layout' % args.output)
+        return
+    with open(args.output, 'w') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# String compiler for the watch display (make strtab).
+#
+# Reads plain ASCII strings from src/strtab.txt and writes src/strtab.h:
+# all strings packed into one table, strtab[], that src/eeprom.c places in
+# the data flash region. Characters are stored as ASCII, which indexes the
+# glyph half of ledtable[]; the last character of each string is marked
+# with bit 7. A string is referred to by its offset into strtab[]:
+#
+#   name = "text"               ->  STR_NAME, STR_NAME_LEN
+#   name[] = "text", "text"     ->  STR_NAME: offset of a list of offsets
+#
+# Offsets are 8 bit, so the whole table is limited to 256 bytes.
+#
+
+import argparse
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def parse(path):
+    """Return [(name, [strings], is_list, line)] in file order."""
+    out = []
+    with open(path) as f:
+        for nr, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            m = re.match(r'(\w+)(\[\])?\s*=\s*(.*)$', line)
+            texts = re.findall(r'"([^"]*)"', m.group(3)) if m else []
+            if not m or not texts or any(not t for t in texts):
+                sys.exit('%s:%d: expected name = "text" or name[] = "text", ...' % (path, nr))
+            if not m.group(2) and len(texts) > 1:
+                sys.exit('%s:%d: use name[] for a list of strings' % (path, nr))
+            out.append((m.group(1).upper(), texts, bool(m.group(2)), nr))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description='compile display strings into src/strtab.h')
+    ap.add_argument('input', nargs='?', default=os.path.join(HERE, '..', 'src', 'strtab.txt'))
+    ap.add_argument('output', nargs='?', default=os.path.join(HERE, '..', 'src', 'strtab.h'))
+    args = ap.parse_args()
+
+    entries = parse(args.input)
+    data, defines, lists = [], [], []
+    for name, texts, is_list, nr in entries:
+        offsets = []
+        for t in texts:
+            bad = [c for c in t if not ' ' <= c <= '~']
+            if bad:
+                sys.exit('%s:%d: no glyph for %s' % (args.input, nr, ', '.join(repr(c) for c in bad)))
+            offsets.append(len(data))
+            data += [ord(c) for c in t]
+            data[-1] |= 0x80
+        if is_list:
+            lists.append((name, texts, offsets))
+        else:
+            defines.append((name, '"%s"' % texts[0], offsets[0], len(texts[0])))
+    # the offset lists go after the strings they point to
+    for name, texts, offsets in lists:
+        defines.append((name, '%d offsets' % len(offsets), len(data), None))
+        data += offsets
+    if len(data) > 256:
+        sys.exit('%s: %d bytes of strings; offsets are 8 bit, 256 at most' % (args.input, len(data)))
+
+    out = ['// generated by tools/mkstrtab.py from %s; do not edit' % os.path.basename(args.input),
+           '//', '// see tools/mkstrtab.py for the format', '',
+           '#define STRTAB_SIZE %d' % len(data), '']
+    for name, what, offset, length in defines:
+        out.append('#define STR_%-12s %3d\t// %s' % (name, offset, what))
+        if length is not None:
+            out.append('#define STR_%-12s %3d' % (name + '_LEN', length))
+    out += ['', '#ifdef STRTAB_DATA',
+            '__code const uint8_t __at (EE_STRTAB) strtab[STRTAB_SIZE] = {']
+    for i in range(0, len(data), 12):
+        out.append('\t' + ', '.join('0x%02X' % b for b in data[i:i + 12]) + ',')
+    out[-1] = out[-1].rstrip(',')
+    out += ['};', '#endif']
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# Thin driver for the ucsim/s51 8051 simulator that ships with sdcc.
+#
+# s51 is started in interactive mode and fed commands over a pipe; each
+# command's output is collected up to the next prompt. Only a handful of
+# ucsim commands are used (break/tbreak/clear/delete, run, state, dump, and
+# set/info hardware for the port pins) so the driver works across the ucsim
+# versions bundled with sdcc >= 3.5.
+#
+# NOTE: ucsim models a classic 12T 8051, not the 1T STC15 core. Its timer0
+#       mode 0 is the 13-bit timer rather than the STC15 16-bit auto-reload
+#       timer, and it has no CLK_DIV. The firmware is therefore built with
+#       -DSIM51 for the simulator (timer0 in mode 1, reloaded by its
+#       interrupt; see main.c), and run at 12 times SYSCLK so that one
+#       machine cycle takes as long as one STC15 clock. Most instructions
+#       take a few more clocks on the STC15 than machine cycles on the 8051,
+#       so cycle counts are a lower bound of the STC15 clocks.
+#
+
+import os
+import re
+import subprocess
+
+PROMPT = re.compile(r'(^|\n)\d+> $')
+STOP = re.compile(r'Stop at 0x([0-9a-fA-F]+)')
+TOTAL = re.compile(r'Total time since last reset\s*=.*?\((\d+) clks\)')
+ISR = re.compile(r'Time in isr\s*=.*?\((\d+) clks\)')
+IDLE = re.compile(r'Time in idle\s*=.*?\((\d+) clks\)')
+PC = re.compile(r'PC\s*=\s*0x([0-9a-fA-F]+)')
+
+# port pin stimulus. the spelling of this command has changed between
+# ucsim versions, so each one is tried in turn on the first pin() and the
+# first one the port reports back ("info hardware port[n]", the Pin line:
+# "Output of outside circuits") is kept; SIM51_PIN_CMD puts another one
+# first. the run stops if none of them takes.
+PIN_CMDS = [c for c in [os.environ.get('SIM51_PIN_CMD'),
+                        'set hardware port[{port}] pins {value:#04x}',
+                        'set hardware port[{port}] pin {value:#04x}',
+                        'set hardware port[{port}] {value:#04x}'] if c]
+PIN_INFO = 'info hardware port[{port}]'
+PIN_STATE = re.compile(r'Pin\s*(\d)\s+[01]{8}\s+0x([0-9a-fA-F]{2})')
+
+# oscillator clocks per machine cycle of the simulated 8051; s51 is run at
+# this many times SYSCLK
+CLOCKS_PER_CYCLE = 12
+
+# pins the watch buttons are wired to (active low)
+SW1 = (3, 3)
+SW2 = (3, 1)
+
+
+def read_map(path):
+    """Return {symbol: address} for the code symbols in an aslink .map file."""
+    syms = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'\s*(?:C:\s+)?([0-9A-Fa-f]{4,8})\s+(_\w+)', line)
+            if m and m.group(2) not in syms:
+                syms[m.group(2)] = int(m.group(1), 16)
+    return syms
+
+
+class Sim51:
+
+    def __init__(self, hexfile, s51='s51', xtal='11.0592M', cpu='8052'):
+        self.proc = subprocess.Popen(
+            [s51, '-t', cpu, '-X', xtal, hexfile],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT, bufsize=0)
+        self.pins = {0: 0xFF, 1: 0xFF, 2: 0xFF, 3: 0xFF}
+        self.pin_cmd = None
+        self._read()
+
+    def _read(self):
+        out = b''
+        while True:
+            c = self.proc.stdout.read(1)
+            if not c:
+                raise RuntimeError('s51 exited:\n' + out.decode(errors='replace'))
+            out += c
+            if c == b' ' and PROMPT.search(out.decode(errors='replace')):
+                return out.decode(errors='replace')
+
+    def cmd(self, line):
+        self.proc.stdin.write((line + '\n').encode())
+        return self._read()
+
+    def close(self):
+        try:
+            self.proc.stdin.write(b'quit\n')
+            self.proc.stdin.close()
+        except OSError:
+            pass
+        self.proc.wait()
+
+    # -- state ---------------------------------------------------------------
+
+    def state(self):
+        """Return (total clocks, clocks in isr, clocks in idle, pc)."""
+        s = self.cmd('state')
+        pc = PC.search(s)
+        return (int(TOTAL.search(s).group(1)),
+                int(ISR.search(s).group(1)) if ISR.search(s) else 0,
+                int(IDLE.search(s).group(1)) if IDLE.search(s) else 0,
+                int(pc.group(1), 16) if pc else None)
+
+    def clocks(self):
+        return self.state()[0]
+
+    def _dump(self, space, addr, n=1):
+        s = self.cmd('dump %s %#x %#x' % (space, addr, addr + n - 1))
+        vals = []
+        for line in s.splitlines():
+            parts = line.split()
+            if parts and parts[0].lower().startswith('0x'):
+                for p in parts[1:]:
+                    if not re.fullmatch(r'[0-9a-fA-F]{2}', p):
+                        break
+                    vals.append(int(p, 16))
+        return vals[:n]
+
+    def iram(self, addr, n=1):
+        return self._dump('iram', addr, n)
+
+    def sfr(self, addr):
+        return self._dump('sfr', addr)[0]
+
+    def return_address(self):
+        """Return address pushed by the call/interrupt that just happened."""
+        sp = self.sfr(0x81)
+        lo, hi = self.iram(sp - 1, 2)
+        return hi << 8 | lo, sp
+
+    # -- control -------------------------------------------------------------
+
+    def set_break(self, addr, temp=False):
+        self.cmd('%s %#x' % ('tbreak' if temp else 'break', addr))
+
+    def clear_break(self, addr):
+        self.cmd('clear %#x' % addr)
+
+    def break_write(self, space, addr):
+        """Break on a write to a memory cell; returns the breakpoint number."""
+        m = re.search(r'(\d+)', self.cmd('break %s w %#x' % (space, addr)))
+        return int(m.group(1)) if m else None
+
+    def delete_break(self, nr):
+        self.cmd('delete %d' % nr)
+
+    def run(self):
+        """Run until a breakpoint; return the pc it stopped at."""
+        # some ucsim builds hand the prompt back before the simulation stops
+        out = self.cmd('run')
+        while not STOP.search(out):
+            out += self._read()
+        return int(STOP.search(out).group(1), 16)
+
+    def pin(self, port_bit, level):
+        port, bit = port_bit
+        if level:
+            self.pins[port] |= 1 << bit
+        else:
+            self.pins[port] &= ~(1 << bit) & 0xFF
+        if self.pin_cmd is None:
+            self.pin_cmd = self._find_pin_cmd(port)
+        self.cmd(self.pin_cmd.format(port=port, value=self.pins[port]))
+
+    def port_pins(self, port):
+        """Pin levels ucsim drives into a port, or None if it doesn't say."""
+        m = PIN_STATE.search(self.cmd(PIN_INFO.format(port=port)))
+        return int(m.group(2), 16) if m else None
+
+    def _find_pin_cmd(self, port):
+        # probe with a value the pins can't have yet, then put them back
+        probe = self.pins[port] ^ 0x55
+        tried = []
+        for c in PIN_CMDS:
+            line = c.format(port=port, value=probe)
+            reply = self.cmd(line).rsplit('\n', 1)[0].strip()  # without the prompt
+            tried.append('%s: %s' % (line, reply or 'no reply'))
+            if self.port_pins(port) == probe:
+                self.cmd(c.format(port=port, value=self.pins[port]))
+                return c
+        raise RuntimeError('s51: no pin command changed port %d; tried:\n  %s\n%s:\n%s'
+                           % (port, '\n  '.join(tried), PIN_INFO.format(port=port),
+                              self.cmd(PIN_INFO.format(port=port))))